@@ -0,0 +1,376 @@
+/**
+ * Benchmarks for the output and string paths of TrIO.
+ *
+ * There is no build system, so build it straight from the repo's root:
+ *     g++ -std=c++11 -O2 -pthread bench/bench.cpp -o trio_bench
+ *
+ * Usage: trio_bench [--pty] [--json FILE] [--filter TEXT] [--time MS]
+ *   --pty       print to a pseudo-terminal instead of /dev/null (*nix only)
+ *   --json      where to write the results (default bench.json)
+ *   --filter    only run benchmarks with TEXT in their name
+ *   --time      roughly how long to run each benchmark (default 200)
+ *
+ * Everything TrIO prints goes to /dev/null (or the pseudo-terminal), and the
+ * report goes to stderr. Bytes written and write syscalls are read from
+ * /proc/self/io, so they are only counted on Linux (-1 elsewhere).
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../trio.hpp"
+
+#if !defined(WINDOWS)
+#include <unistd.h>
+#endif
+
+namespace
+{
+    /** One benchmark: runs its operation some number of times */
+    struct Bench
+    {
+        std::string name;
+        std::function<void(size_t)> run;
+    };
+
+    /** What a benchmark measured */
+    struct Result
+    {
+        std::string name;
+        size_t iterations;
+        double ns_per_op;
+        long long bytes;
+        long long syscalls;
+    };
+
+    /** Keeps the compiler from throwing away results nobody looks at */
+    volatile size_t sink;
+
+    /**
+     * Reads the bytes written and write syscalls made by this process so far
+     * @param bytes set to the bytes written, or -1 if we can't tell
+     * @param syscalls set to the write syscalls made, or -1 if we can't tell
+     */
+    void read_io_counts(long long &bytes, long long &syscalls)
+    {
+        bytes = -1;
+        syscalls = -1;
+        FILE *file = fopen("/proc/self/io", "r");
+        if (!file)
+            return;
+        char line[128];
+        while (fgets(line, sizeof(line), file))
+        {
+            long long value;
+            if (sscanf(line, "wchar: %lld", &value) == 1)
+                bytes = value;
+            else if (sscanf(line, "syscw: %lld", &value) == 1)
+                syscalls = value;
+        }
+        fclose(file);
+    }
+
+    /**
+     * Runs a benchmark with more and more iterations until it takes at least
+     * min_ms, then measures it
+     * @param bench the benchmark to run
+     * @param min_ms how long the measured run should take
+     * @param io the IO object the benchmarks print with, flushed after
+     * each run so buffered output is counted
+     * @return the measurements
+     */
+    Result measure(const Bench &bench, double min_ms, trio::IO &io)
+    {
+        typedef std::chrono::steady_clock clock;
+        Result result;
+        result.name = bench.name;
+        size_t iterations = 1;
+        while (true)
+        {
+            long long bytes_before, syscalls_before, bytes_after, syscalls_after;
+            std::fflush(stdout);
+            read_io_counts(bytes_before, syscalls_before);
+            clock::time_point start = clock::now();
+            bench.run(iterations);
+            io.flush();
+            std::cout << std::flush;
+            double elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+            read_io_counts(bytes_after, syscalls_after);
+            if (elapsed_ms >= min_ms || iterations >= ((size_t)1 << 30))
+            {
+                result.iterations = iterations;
+                result.ns_per_op = elapsed_ms * 1e6 / iterations;
+                result.bytes = bytes_before < 0 ? -1 : bytes_after - bytes_before;
+                result.syscalls = syscalls_before < 0 ? -1 : syscalls_after - syscalls_before;
+                return result;
+            }
+            // Aim a bit past the time we need so the next run is usually the last
+            double scale = elapsed_ms > 0 ? min_ms * 1.2 / elapsed_ms : 100;
+            if (scale > 100)
+                scale = 100;
+            if (scale < 2)
+                scale = 2;
+            iterations = (size_t)(iterations * scale);
+        }
+    }
+
+    /**
+     * Sends stdout somewhere that costs as little as possible to print to
+     * @param use_pty whether to use a pseudo-terminal instead of /dev/null
+     * @return false if the output couldn't be redirected
+     */
+    bool redirect_stdout(bool use_pty)
+    {
+        std::fflush(stdout);
+#if defined(WINDOWS)
+        if (use_pty)
+            return false;
+        return freopen("NUL", "w", stdout) != NULL;
+#else
+        int fd;
+        if (use_pty)
+        {
+            int master = posix_openpt(O_RDWR | O_NOCTTY);
+            if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+                return false;
+            fd = open(ptsname(master), O_RDWR | O_NOCTTY);
+            if (fd < 0)
+                return false;
+            // Keep reading the other end so the terminal never fills up
+            std::thread([master]() {
+                char drain[65536];
+                while (read(master, drain, sizeof(drain)) > 0)
+                {
+                }
+            }).detach();
+        }
+        else
+            fd = open("/dev/null", O_WRONLY);
+        if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0)
+            return false;
+        close(fd);
+        return true;
+#endif
+    }
+
+    /** Writes the results as JSON */
+    bool write_json(const char *path, const std::vector<Result> &results, bool use_pty)
+    {
+        FILE *file = fopen(path, "w");
+        if (!file)
+            return false;
+        fprintf(file, "{\n  \"output\": \"%s\",\n  \"benchmarks\": [\n", use_pty ? "pty" : "null");
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result &r = results[i];
+            fprintf(file,
+                    "    {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.3f, "
+                    "\"bytes_written\": %lld, \"write_syscalls\": %lld}%s\n",
+                    r.name.c_str(), r.iterations, r.ns_per_op, r.bytes, r.syscalls,
+                    i + 1 < results.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+        return fclose(file) == 0;
+    }
+
+    /** A playing card like the ones in the README, for fusing */
+    std::string card(int suit)
+    {
+        std::string color = std::string("&") + char('1' + suit % 8) + '8';
+        std::string text;
+        text += color + "┌────┐\n";
+        text += color + "│ 9" + (suit % 2 ? "♥" : "♠") + " │\n";
+        text += color + "│    │\n";
+        text += color + "│ " + (suit % 2 ? "♥" : "♠") + "9 │\n";
+        text += color + "└────┘\n";
+        return text;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    bool use_pty = false;
+    const char *json_path = "bench.json";
+    const char *filter = "";
+    double min_ms = 200;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--pty"))
+            use_pty = true;
+        else if (!strcmp(argv[i], "--json") && i + 1 < argc)
+            json_path = argv[++i];
+        else if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (!strcmp(argv[i], "--time") && i + 1 < argc)
+            min_ms = atof(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--pty] [--json FILE] [--filter TEXT] [--time MS]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!redirect_stdout(use_pty))
+    {
+        fprintf(stderr, "could not redirect stdout to %s\n", use_pty ? "a pseudo-terminal" : "/dev/null");
+        return 1;
+    }
+
+    trio::IO io;
+    trio::IO stream_io(std::cout);
+    trio::MemorySink memory;
+    trio::IO memory_io(memory);
+    trio::VirtualTerminal terminal(24, 80);
+    trio::IO terminal_io(terminal);
+
+    // Inputs for the benchmarks
+    std::string plain_line;
+    for (int i = 0; i < 8; i++)
+        plain_line += "The quick brown fox ";
+    plain_line += "\n";
+    std::string markup_line;
+    for (char let = 'a', code = '1'; let <= 'z'; let++)
+    {
+        code = code < '8' ? code + 1 : '2';
+        markup_line += std::string(1, '&') + code + '0' + let + let;
+    }
+    markup_line += "\n";
+    std::string markup_output;
+    {
+        trio::MemorySink output;
+        trio::IO output_io(output);
+        output_io << markup_line;
+        markup_output = output.data();
+    }
+    std::string unicode_line;
+    for (int i = 0; i < 10; i++)
+        unicode_line += "┌──┐日本語 ♠♥ ";
+    unicode_line += "\n";
+    std::vector<std::string> cards;
+    for (int i = 0; i < 50; i++)
+        cards.push_back(card(i));
+    std::vector<std::string> cards_2(cards.begin(), cards.begin() + 2);
+    std::vector<std::string> cards_10(cards.begin(), cards.begin() + 10);
+    std::string csv;
+    for (int i = 0; i < 100; i++)
+        csv += "field" + std::to_string(i) + (i % 10 == 9 ? ";" : ",");
+    std::string template_text;
+    for (int i = 0; i < 20; i++)
+        template_text += "Hello {name}, your score is {score}. ";
+
+    std::vector<Bench> benches;
+    benches.push_back(Bench{"io_string_plain", [&](size_t n) {
+                                for (size_t i = 0; i < n; i++)
+                                    io << plain_line;
+                            }});
+    benches.push_back(Bench{"io_string_markup", [&](size_t n) {
+                                for (size_t i = 0; i < n; i++)
+                                    io << markup_line;
+                            }});
+    benches.push_back(Bench{"io_string_unicode", [&](size_t n) {
+                                for (size_t i = 0; i < n; i++)
+                                    io << unicode_line;
+                            }});
+    benches.push_back(Bench{"io_string_markup_buffered", [&](size_t n) {
+                                io.set_buffered(true);
+                                for (size_t i = 0; i < n; i++)
+                                    io << markup_line;
+                                io.set_buffered(false);
+                            }});
+    benches.push_back(Bench{"io_string_markup_stream", [&](size_t n) {
+                                // The same output through cout instead of write()
+                                for (size_t i = 0; i < n; i++)
+                                    stream_io << markup_line;
+                            }});
+    benches.push_back(Bench{"io_string_markup_memory", [&](size_t n) {
+                                for (size_t i = 0; i < n; i++)
+                                {
+                                    memory.clear();
+                                    memory_io << markup_line;
+                                }
+                            }});
+    benches.push_back(Bench{"io_string_markup_virtual", [&](size_t n) {
+                                // Printed and then read back by a VirtualTerminal
+                                for (size_t i = 0; i < n; i++)
+                                    terminal_io << markup_line;
+                            }});
+    benches.push_back(Bench{"virtual_terminal_write", [&](size_t n) {
+                                // Only the reading, of what printing markup_line sends
+                                for (size_t i = 0; i < n; i++)
+                                    terminal.write(markup_output.data(), markup_output.size());
+                            }});
+    benches.push_back(Bench{"io_set_color", [&](size_t n) {
+                                // Colors are only sent once text uses them
+                                for (size_t i = 0; i < n; i++)
+                                    io << trio::Color(i % 8 + 1, (i / 8) % 8 + 1) << 'x';
+                            }});
+    benches.push_back(Bench{"io_set_color_rgb", [&](size_t n) {
+                                // A gradient, like a heatmap
+                                io.set_color_depth(trio::COLORS_TRUE);
+                                for (size_t i = 0; i < n; i++)
+                                    io << trio::Color(trio::rgb(i % 256, (i / 256) % 256, 128), 0) << 'x';
+                            }});
+    benches.push_back(Bench{"io_set_color_rgb_256", [&](size_t n) {
+                                // The same gradient, fitted to the 256 color palette
+                                io.set_color_depth(trio::COLORS_256);
+                                for (size_t i = 0; i < n; i++)
+                                    io << trio::Color(trio::rgb(i % 256, (i / 256) % 256, 128), 0) << 'x';
+                            }});
+    benches.push_back(Bench{"io_point", [&](size_t n) {
+                                for (size_t i = 0; i < n; i++)
+                                    io << trio::Point(i * 7 % 24, i * 13 % 80) << 'x';
+                            }});
+    benches.push_back(Bench{"fuse_2", [&](size_t n) {
+                                for (size_t i = 0; i < n; i++)
+                                    sink = sink + trio::fuse(cards_2).size();
+                            }});
+    benches.push_back(Bench{"fuse_10", [&](size_t n) {
+                                for (size_t i = 0; i < n; i++)
+                                    sink = sink + trio::fuse(cards_10).size();
+                            }});
+    benches.push_back(Bench{"fuse_50", [&](size_t n) {
+                                for (size_t i = 0; i < n; i++)
+                                    sink = sink + trio::fuse(cards).size();
+                            }});
+    benches.push_back(Bench{"fuse_10_padded", [&](size_t n) {
+                                for (size_t i = 0; i < n; i++)
+                                    sink = sink + trio::fuse(cards_10, true).size();
+                            }});
+    benches.push_back(Bench{"split", [&](size_t n) {
+                                for (size_t i = 0; i < n; i++)
+                                    sink = sink + trio::split(csv, ',').size();
+                            }});
+    benches.push_back(Bench{"rsplit", [&](size_t n) {
+                                for (size_t i = 0; i < n; i++)
+                                    sink = sink + trio::rsplit(csv, "[,;]").size();
+                            }});
+    benches.push_back(Bench{"replace_all", [&](size_t n) {
+                                for (size_t i = 0; i < n; i++)
+                                    sink = sink + trio::replace_all(template_text, "{name}", "Player One").size();
+                            }});
+
+    std::vector<Result> results;
+    fprintf(stderr, "%-28s %12s %12s %14s\n", "benchmark", "ns/op", "bytes/op", "syscalls/op");
+    for (size_t i = 0; i < benches.size(); i++)
+    {
+        if (benches[i].name.find(filter) == std::string::npos)
+            continue;
+        Result r = measure(benches[i], min_ms, io);
+        results.push_back(r);
+        if (r.bytes < 0)
+            fprintf(stderr, "%-28s %12.1f %12s %14s\n", r.name.c_str(), r.ns_per_op, "-", "-");
+        else
+            fprintf(stderr, "%-28s %12.1f %12.1f %14.3f\n", r.name.c_str(), r.ns_per_op,
+                    (double)r.bytes / r.iterations, (double)r.syscalls / r.iterations);
+    }
+    if (!write_json(json_path, results, use_pty))
+    {
+        fprintf(stderr, "could not write %s\n", json_path);
+        return 1;
+    }
+    fprintf(stderr, "results written to %s\n", json_path);
+}
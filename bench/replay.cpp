@@ -0,0 +1,62 @@
+/**
+ * Plays back a recording made with IO::record() (or a trio::Recorder, or
+ * asciinema) on the terminal.
+ *
+ * There is no build system, so build it straight from the repo's root:
+ *     g++ -std=c++11 -O2 -pthread bench/replay.cpp -o trio_replay
+ *
+ * Usage: trio_replay [--speed N | --max] FILE
+ *   --speed     play N times faster than it was recorded (default 1)
+ *   --max       play as fast as the output takes it
+ *
+ * Playing at --max with stdout sent to /dev/null or a terminal makes a
+ * recording of a real program into a rendering benchmark. What was played,
+ * and how fast, is reported on stderr.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../trio.hpp"
+
+#if !defined(WINDOWS)
+#include <unistd.h>
+#endif
+
+int main(int argc, char **argv)
+{
+    double speed = 1;
+    const char *path = NULL;
+    bool usage = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--speed") && i + 1 < argc)
+            speed = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--max"))
+            speed = 0;
+        else if (argv[i][0] != '-' && path == NULL)
+            path = argv[i];
+        else
+            usage = true;
+    }
+    if (usage || path == NULL || speed < 0)
+    {
+        fprintf(stderr, "usage: %s [--speed N | --max] FILE\n", argv[0]);
+        return 2;
+    }
+
+#if defined(WINDOWS)
+    trio::FdSink out(_fileno(stdout));
+#else
+    trio::FdSink out(STDOUT_FILENO);
+#endif
+    trio::ReplayStats stats;
+    if (!trio::replay(path, out, speed, &stats))
+    {
+        fprintf(stderr, "could not read %s\n", path);
+        return 1;
+    }
+    fprintf(stderr, "\n%zu events, %zu bytes, recorded in %.1f ms, played in %.1f ms (%.1f MB/s)\n",
+            stats.events, stats.bytes, stats.recorded_ms, stats.played_ms,
+            stats.played_ms > 0 ? stats.bytes / stats.played_ms / 1000 : 0.0);
+    return 0;
+}
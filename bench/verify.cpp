@@ -0,0 +1,239 @@
+/**
+ * Checks that TrIO's optimized output paths leave the same screen behind as
+ * the naive ones, by printing both ways into VirtualTerminals and comparing
+ * them.
+ *
+ * There is no build system, so build it straight from the repo's root:
+ *     g++ -std=c++11 -pthread bench/verify.cpp -o trio_verify
+ *
+ * Usage: trio_verify
+ *
+ * Each check is reported on stderr, and the exit status is 1 if any of them
+ * failed.
+ */
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include "../trio.hpp"
+
+namespace
+{
+    /** One check: draws something two ways and says whether they match */
+    struct Check
+    {
+        std::string name;
+        std::function<bool()> run;
+    };
+
+    /**
+     * Prints text at a row/column with an absolute cursor move (CUP), the
+     * way a program that never tracks the cursor would
+     * @param terminal where to print
+     * @param row the row to print at (starting at 0)
+     * @param col the column to print at (starting at 0)
+     * @param text the text to print, with escape sequences if any
+     */
+    void naive_print(trio::VirtualTerminal &terminal, int row, int col, const std::string &text)
+    {
+        std::string codes = "\033[" + std::to_string(row + 1) + ";" + std::to_string(col + 1) + "f" + text;
+        terminal.write(codes.data(), codes.size());
+    }
+
+    /**
+     * Prints the rows of two VirtualTerminals that differ, to see what went
+     * wrong
+     */
+    void show_difference(const trio::VirtualTerminal &got, const trio::VirtualTerminal &expected)
+    {
+        for (unsigned short row = 0; row < got.rows(); row++)
+        {
+            if (got.row_text(row) != expected.row_text(row))
+                fprintf(stderr, "    row %d: \"%s\", expected \"%s\"\n", row, got.row_text(row).c_str(), expected.row_text(row).c_str());
+        }
+    }
+
+    /**
+     * Whether two VirtualTerminals show the same Cells, showing the rows
+     * that differ if they don't
+     */
+    bool same(const trio::VirtualTerminal &got, const trio::VirtualTerminal &expected)
+    {
+        if (got == expected)
+            return true;
+        show_difference(got, expected);
+        return false;
+    }
+} // namespace
+
+int main()
+{
+    std::vector<Check> checks;
+
+    checks.push_back(Check{"cursor moves out of a scroll region", []() {
+                               // A header and a footer around a scrolling log
+                               trio::VirtualTerminal terminal(10, 20);
+                               trio::IO io(terminal);
+                               io.set_scrolling(true);
+                               io.set_scroll_region(2, 7);
+                               io << trio::Point(0, 0) << "HEAD ";
+                               io << trio::Point(9, 5) << "FOOT";
+                               io << trio::Point(4, 0) << "log" << trio::Point(1, 3) << "sub";
+                               io << trio::Point(3, 1) << "in";
+
+                               trio::VirtualTerminal expected(10, 20);
+                               expected.write("\033[3;8r", 6);
+                               naive_print(expected, 0, 0, "HEAD ");
+                               naive_print(expected, 9, 5, "FOOT");
+                               naive_print(expected, 4, 0, "log");
+                               naive_print(expected, 1, 3, "sub");
+                               naive_print(expected, 3, 1, "in");
+                               return same(terminal, expected);
+                           }});
+    checks.push_back(Check{"cursor moves inside a scroll region", []() {
+                               trio::VirtualTerminal terminal(10, 20);
+                               trio::IO io(terminal);
+                               io.set_scrolling(true);
+                               io.set_scroll_region(2, 7);
+                               io << trio::Point(7, 0) << "bottom";
+                               io << trio::Point(2, 4) << "top" << trio::Point(6, 2) << "six";
+                               io << trio::Point(7, 0) << "x";
+
+                               trio::VirtualTerminal expected(10, 20);
+                               expected.write("\033[3;8r", 6);
+                               naive_print(expected, 7, 0, "bottom");
+                               naive_print(expected, 2, 4, "top");
+                               naive_print(expected, 6, 2, "six");
+                               naive_print(expected, 7, 0, "x");
+                               return same(terminal, expected);
+                           }});
+    checks.push_back(Check{"culling at the edges of the terminal", []() {
+                               trio::VirtualTerminal terminal(5, 10);
+                               trio::IO io(terminal);
+                               io << trio::Point(1, 6) << "abcdefgh";
+                               io << trio::Point(7, 0) << "gone" << trio::Point(2, 12) << "gone";
+                               io << trio::Point(3, 8) << "cut\nnext";
+
+                               trio::VirtualTerminal expected(5, 10);
+                               naive_print(expected, 1, 6, "abcd");
+                               naive_print(expected, 3, 8, "cu");
+                               naive_print(expected, 4, 0, "next");
+                               return same(terminal, expected);
+                           }});
+    checks.push_back(Check{"text scrolling after a Point", []() {
+                               // A title, then a log that runs off of the
+                               // bottom and has to scroll
+                               trio::VirtualTerminal terminal(5, 10);
+                               trio::IO io(terminal);
+                               trio::VirtualTerminal expected(5, 10);
+                               trio::IO naive(expected);
+                               naive.set_culling(false);
+                               io << trio::Point(0, 0) << "Title\n";
+                               naive << trio::Point(0, 0) << "Title\n";
+                               for (int i = 1; i <= 8; i++)
+                               {
+                                   io << "line" << i << "\n";
+                                   naive << "line" << i << "\n";
+                               }
+                               io << "a line that wraps";
+                               naive << "a line that wraps";
+                               return same(terminal, expected) && terminal.row_text(3) == "a line tha";
+                           }});
+    checks.push_back(Check{"culling ends with the Point's line", []() {
+                               trio::VirtualTerminal terminal(5, 10);
+                               trio::IO io(terminal);
+                               trio::VirtualTerminal expected(5, 10);
+                               trio::IO naive(expected);
+                               naive.set_culling(false);
+                               io << trio::Point(0, 0) << "title\n";
+                               naive << trio::Point(0, 0) << "title\n";
+                               io << "abcdefghijklmnop\n";
+                               naive << "abcdefghijklmnop\n";
+                               return same(terminal, expected) && terminal.row_text(2) == "klmnop";
+                           }});
+    checks.push_back(Check{"Screen presents only what changed", []() {
+                               trio::VirtualTerminal terminal(8, 30);
+                               trio::IO io(terminal);
+                               trio::Screen screen(8, 30);
+                               screen.print(0, 0, "Status: OK", trio::Color(trio::GREEN));
+                               screen.print(3, 2, "\xe4\xb8\x96\xe7\x95\x8c wide", trio::Color(trio::WHITE, trio::BLUE));
+                               screen.print(7, 20, "bottom right");
+                               screen.present(io);
+                               screen.print(0, 8, "!!", trio::Color(trio::RED));
+                               screen.print(3, 3, "x");
+                               screen.print(5, 0, "new row", trio::Color(trio::YELLOW));
+                               screen.present(io);
+                               screen.print(5, 4, "ROW", trio::Color(trio::CYAN));
+                               screen.present(io, std::vector<trio::Rect>(1, trio::Rect(5, 0, 1, 30)));
+
+                               // The same frame, drawn in one go
+                               trio::VirtualTerminal expected(8, 30);
+                               trio::IO redraw(expected);
+                               screen.invalidate();
+                               screen.present(redraw);
+                               return same(terminal, expected);
+                           }});
+    checks.push_back(Check{"Compositor presents only damage", []() {
+                               trio::VirtualTerminal terminal(10, 40);
+                               trio::IO io(terminal);
+                               trio::Compositor compositor(10, 40);
+                               trio::Pane back(trio::Rect(0, 0, 10, 40));
+                               trio::Pane popup(trio::Rect(2, 5, 4, 12), 1);
+                               trio::Pane clock(trio::Rect(0, 32, 1, 8), 2);
+                               compositor.add(back).add(popup).add(clock);
+                               back.print(1, 0, "&20Ready\n&30Waiting for input");
+                               popup.fill(trio::Cell(' ', trio::WHITE, trio::BLUE));
+                               popup.print(1, 1, "&74Popup!");
+                               clock.print(0, 0, "12:00:00");
+                               compositor.present(io);
+                               clock.print(0, 0, "12:00:01");
+                               popup.move(4, 20);
+                               back.print(8, 2, "&10log line");
+                               compositor.present(io);
+                               popup.set_z(-1);
+                               clock.show(false);
+                               compositor.present(io);
+                               compositor.remove(popup);
+                               back.print(9, 0, "done");
+                               compositor.present(io);
+
+                               trio::VirtualTerminal expected(10, 40);
+                               trio::IO redraw(expected);
+                               compositor.invalidate();
+                               compositor.present(redraw);
+                               return same(terminal, expected);
+                           }});
+    checks.push_back(Check{"LogTail scrolling and redrawing", []() {
+                               // The same log, appended by scrolling the
+                               // terminal and by redrawing every line
+                               trio::VirtualTerminal terminal(8, 30);
+                               trio::IO io(terminal);
+                               io.set_scrolling(true);
+                               trio::VirtualTerminal expected(8, 30);
+                               trio::IO redraw(expected);
+                               redraw.set_scrolling(false);
+                               io << trio::Point(0, 0) << "&30My Server" << trio::Point(7, 0) << "footer";
+                               redraw << trio::Point(0, 0) << "&30My Server" << trio::Point(7, 0) << "footer";
+                               trio::LogTail log(trio::Rect(1, 0, 6, 30));
+                               trio::LogTail naive(trio::Rect(1, 0, 6, 30));
+                               for (int i = 0; i < 15; i++)
+                               {
+                                   const std::string line = "&20[ok]&00 request " + std::to_string(i) + (i % 4 == 0 ? " that is too long to fit on a row" : "");
+                                   log.append(io, line);
+                                   naive.append(redraw, line);
+                               }
+                               return io.can_scroll(log.area()) && same(terminal, expected);
+                           }});
+
+    int failed = 0;
+    for (size_t i = 0; i < checks.size(); i++)
+    {
+        const bool passed = checks[i].run();
+        fprintf(stderr, "%-40s %s\n", checks[i].name.c_str(), passed ? "ok" : "FAILED");
+        if (!passed)
+            failed++;
+    }
+    if (failed > 0)
+        fprintf(stderr, "%d of %zu checks failed\n", failed, checks.size());
+    return failed > 0 ? 1 : 0;
+}
@@ -67,11 +67,14 @@ int main()
     io.clear() << "Testing clear, move & sleep by printing X's";
     for (int i = 0; i < 3; i++)
         io.sleep(1333) << '.';
+    // Use the terminal's real size, or guess if it can't be told
+    int rows = io.rows() ? io.rows() : 24;
+    int cols = io.cols() ? io.cols() : 80;
     for (int i = 0; i < 40; i++)
     {
         short fg = rand() % 8 + 1;
-        short row = rand() % 40;
-        short col = rand() % 80;
+        short row = rand() % rows;
+        short col = rand() % cols;
         io.sleep(100) << trio::Point(row, col) << trio::Color(fg, trio::BLACK) << 'X';
     }
     // Wait 3 seconds
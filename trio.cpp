@@ -0,0 +1,5 @@
+// Compiles the TrIO implementation once, for projects that define
+// TRIO_SEPARATE_COMPILATION instead of using trio.hpp as a header-only
+// library. Build this file along with the rest of the program.
+#define TRIO_IMPLEMENTATION
+#include "trio.hpp"
@@ -4,24 +4,41 @@
 #define WINDOWS true
 #endif
 
+// Some features need a newer C++ standard than the rest of TrIO
+#if __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+#define TRIO_CPP14 true
+#endif
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define TRIO_CPP17 true
+#endif
+
+// TrIO is header-only by default. To compile it once instead of in every
+// file that includes it, define TRIO_SEPARATE_COMPILATION for the whole
+// project and build trio.cpp (which defines TRIO_IMPLEMENTATION) along
+// with the rest of the program. This header then only declares things.
+#if defined(TRIO_IMPLEMENTATION) && !defined(TRIO_SEPARATE_COMPILATION)
+#define TRIO_SEPARATE_COMPILATION true
+#endif
+#if defined(TRIO_SEPARATE_COMPILATION)
+#define TRIO_INLINE
+#else
+#define TRIO_INLINE inline
+#endif
+
 // Include for all platforms
 #include <chrono>
-#include <codecvt>
 #include <iostream>
-#include <regex>
+#include <memory>
+#include <stdexcept>
 #include <string>
-#include <thread>
 #include <vector>
+#if defined(TRIO_CPP17)
+#include <string_view>
+#endif
 
 // Include only for Windows
 #if defined(WINDOWS)
-#include <fcntl.h>
-#include <io.h>
 #include <windows.h>
-#else
-// Include only for *nix
-#include <unistd.h>
-#include <termios.h>
 #endif
 
 namespace trio
@@ -69,39 +86,169 @@ namespace trio
         WHITE    // Code: 8
     };
 
+    /**
+     * How many colors a terminal can show. Colors it can't show are drawn
+     * with the closest one it can.
+     */
+    enum ColorDepth
+    {
+        COLORS_8,   // Only the TrIO color codes above
+        COLORS_256, // The 256 color palette (see palette())
+        COLORS_TRUE // Any 24-bit color (see rgb())
+    };
+
+    /**
+     * The color code for an entry of the terminal's 256 color palette, to use
+     * in a Color or Cell like the TrIO color codes
+     */
+    TRIO_INLINE unsigned int palette(unsigned char index);
+
+    /**
+     * The color code for a 24-bit color, to use in a Color or Cell like the
+     * TrIO color codes
+     */
+    TRIO_INLINE unsigned int rgb(unsigned char red, unsigned char green, unsigned char blue);
+
     /** Fuses two multi-line string together for printing side-by-side */
-    inline string fuse(string left, string right, bool pad = false);
+    TRIO_INLINE string fuse(const string &left, const string &right, bool pad = false);
 
     /** Fuses multiple multi-line strings together for printing side-by-side. */
-    inline string fuse(std::initializer_list<string> strings, bool pad = false);
+    TRIO_INLINE string fuse(std::initializer_list<string> strings, bool pad = false);
 
     /** Fuses multiple multi-line strings together for printing side-by-side. */
-    inline string fuse(std::vector<string> strings, bool pad = false);
+    TRIO_INLINE string fuse(const std::vector<string> &strings, bool pad = false);
 
     /** Split a string and store each new substring in a vector. */
-    inline vector<string> split(string text, char delim, bool include = false);
+    TRIO_INLINE vector<string> split(const string &text, char delim, bool include = false);
+
+#if defined(TRIO_CPP17)
+    /**
+     * Split a string like split(), but each substring points into the
+     * original text instead of being a copy. The text must stay alive (and
+     * unchanged) for as long as the substrings are used.
+     */
+    TRIO_INLINE vector<std::string_view> split_view(std::string_view text, char delim, bool include = false);
+#endif
 
     /**
      * Split a string, using a regular expression as a delimeter, and store
      * each new substring in a vector.
      */
-    inline vector<string> rsplit(string text, string delim, bool include = false);
+    TRIO_INLINE vector<string> rsplit(const string &text, const string &delim, bool include = false);
 
     /** Replaces all instances of a substring in a text with a new string. */
-    inline string replace_all(string text, string from, string to);
+    TRIO_INLINE string replace_all(string text, string from, string to);
+
+    /** Appends the UTF-8 encoding of a unicode code point to a string. */
+    TRIO_INLINE void utf8_append(string &text, unsigned int code_point);
+
+    /**
+     * Decodes the unicode code point starting at pos in some UTF-8 text and
+     * moves pos past it. Invalid bytes decode to U+FFFD.
+     */
+    TRIO_INLINE unsigned int utf8_next(const char *text, size_t size, size_t &pos);
+
+    /**
+     * How many columns a unicode code point takes up on the terminal: 0 for
+     * control characters and combining marks, 2 for wide characters like
+     * Chinese or emoji, otherwise 1.
+     */
+    TRIO_INLINE int char_width(unsigned int code_point);
+
+    /**
+     * How many columns text takes up when printed, skipping color codes.
+     * For multi-line text, this is the width of the widest line.
+     */
+    TRIO_INLINE size_t text_width(const string &text);
 
     /** Sleeps the thread for some time (waits time before continuing) */
-    inline void sleep_ms(int ms);
+    TRIO_INLINE void sleep_ms(int ms);
 
     /** Clears all the text in the terminal */
-    inline void clear_screen();
+    TRIO_INLINE void clear_screen();
 
     /**
      * It is easier to consistently pass in strings instead of keeping track of
      * wide vs narrow strings. So, we will overload << to make wostreams able to
      * work with strings (by converting them inside the operation to wstring)
      */
-    inline std::wostream &operator<<(wostream &wout, string text);
+    TRIO_INLINE std::wostream &operator<<(wostream &wout, const string &text);
+
+    /**
+     * Internal helpers. These are not part of the TrIO interface and may
+     * change at any time.
+     */
+    namespace detail
+    {
+        /**
+         * Finds the first '&' or '\n' in [first, last), or last if there is
+         * none. Uses the fastest implementation the CPU supports.
+         */
+        TRIO_INLINE const char *find_markup(const char *first, const char *last);
+
+        /**
+         * Scans text for TrIO color codes in a single pass and reports what
+         * should be printed to a handler, which must provide
+         * text(const char *, size_t) and color(unsigned short, unsigned short)
+         */
+        template <class Handler>
+        inline void scan_markup(const char *text, size_t size, Handler &handler);
+
+        /** A line of text inside some larger string */
+        struct LineSpan
+        {
+            const char *text;
+            size_t size;
+            // The line's width in columns, only filled in when needed
+            size_t width;
+        };
+
+        /**
+         * Splits text at every delim character the way split() does, and
+         * gives each piece to add(const char *, size_t) without copying it
+         */
+        template <class Add>
+        inline void split_char(const char *text, size_t size, char delim, bool include, Add add);
+
+        /**
+         * Finds the lines of a string, the same way split(text, '\n') does,
+         * without copying them
+         */
+        TRIO_INLINE void split_lines(const string &text, vector<LineSpan> &lines);
+
+        /**
+         * Fuses panels onto the lines of base (if it isn't null) in a single
+         * pass, with the same result as fusing them on one at a time
+         */
+        TRIO_INLINE string fuse_panels(const string *base, const string *panels, size_t count, bool pad);
+
+        /** Whether a code point is in a sorted list of [first, last] ranges */
+        TRIO_INLINE bool in_ranges(unsigned int code_point, const unsigned int (*ranges)[2], size_t count);
+
+        /** How many columns text without color codes takes up */
+        TRIO_INLINE size_t plain_width(const char *text, size_t size);
+
+        /** How many columns a line with color codes takes up (cached) */
+        TRIO_INLINE size_t line_width(const char *text, size_t size);
+
+        /** Reads the keyboard in the background for an IO object */
+        class InputReader;
+
+        /** The queue and thread behind a RenderThread */
+        class RenderQueue;
+
+        /** The ring buffer and thread behind a Recorder */
+        class RecordWriter;
+
+        /**
+         * Converts UTF-8 text to wide characters (UTF-16 where wchar_t is 16
+         * bits). wide needs room for size characters.
+         */
+        TRIO_INLINE size_t widen(const char *text, size_t size, wchar_t *wide);
+
+        /** Converts UTF-8 text to wide characters and sends it to wout */
+        TRIO_INLINE void write_wide(wostream &wout, const char *text, size_t size);
+    } // namespace detail
 
     /**
      * A Point object is used to move the cursor on the terminal.
@@ -114,26 +261,451 @@ namespace trio
         unsigned short row;
         unsigned short col;
         /** Creates a point */
-        inline Point(const unsigned short &row, const unsigned short &col);
+        TRIO_INLINE Point(const unsigned short &row, const unsigned short &col);
     };
     typedef Point pnt;
     typedef Point p;
 
+    /**
+     * A Rect is a rectangle of cells on the terminal: the row/column of its
+     * top left corner and how many rows and columns it covers.
+     */
+    class Rect
+    {
+    public:
+        unsigned short row;
+        unsigned short col;
+        unsigned short rows;
+        unsigned short cols;
+        /** Creates a Rect */
+        TRIO_INLINE Rect(const unsigned short &row = 0, const unsigned short &col = 0, const unsigned short &rows = 0, const unsigned short &cols = 0);
+        /** Whether the Rect covers no cells at all */
+        TRIO_INLINE bool empty() const;
+        /** The part of this Rect that is inside another one */
+        TRIO_INLINE Rect intersect(const Rect &other) const;
+        /** The smallest Rect that covers both Rects */
+        TRIO_INLINE Rect unite(const Rect &other) const;
+        TRIO_INLINE bool operator==(const Rect &other) const;
+        TRIO_INLINE bool operator!=(const Rect &other) const;
+    };
+
     /**
      * A Color object is used to color the strings being sent to the terminal.
      * When sent to an IO object, the terminal will begin using the specified
-     * foreground and background colors from the Color object.
+     * foreground and background colors from the Color object. Each of them is
+     * a TrIO color code, or a code from palette() or rgb().
      */
     class Color
     {
     public:
-        unsigned short fg;
-        unsigned short bg;
+        unsigned int fg;
+        unsigned int bg;
         /** Creates a Color object */
-        inline Color(const unsigned short &fg, const unsigned short &bg = 0);
+        TRIO_INLINE Color(const unsigned int &fg, const unsigned int &bg = 0);
+        TRIO_INLINE bool operator==(const Color &other) const;
+        TRIO_INLINE bool operator!=(const Color &other) const;
     };
     typedef Color col;
 
+    /**
+     * One piece of parsed markup: an optional color change followed by a
+     * span of text to print.
+     */
+    struct MarkupEntry
+    {
+        bool color;
+        unsigned short fg;
+        unsigned short bg;
+        size_t offset;
+        size_t length;
+    };
+
+    /**
+     * A Markup object holds a string that has already been scanned for color
+     * codes. Printing it to an IO object is the same as printing the original
+     * string, but no parsing has to happen again, so strings that are printed
+     * over and over (like templates and frames) only pay for parsing once.
+     */
+    class Markup
+    {
+    public:
+        /** Parses a string containing color codes */
+        TRIO_INLINE explicit Markup(const string &source = "");
+        TRIO_INLINE explicit Markup(const char *source);
+
+        /** The text to print, with all of the color codes removed */
+        TRIO_INLINE const string &text() const;
+        /** The color changes and spans of text, in order */
+        TRIO_INLINE const vector<MarkupEntry> &entries() const;
+
+    private:
+        string printable;
+        vector<MarkupEntry> parsed;
+
+        /** Receives the results of scanning the source string */
+        struct Builder
+        {
+            Markup &markup;
+            TRIO_INLINE void text(const char *text, size_t size);
+            TRIO_INLINE void color(unsigned short fg, unsigned short bg);
+        };
+    };
+
+#if defined(TRIO_CPP14)
+    /**
+     * Markup that is parsed at compile time. Create these with
+     * trio::markup("...") in a constexpr variable; a bad color code in the
+     * string will then fail the build instead of printing garbage.
+     * The size is the size of the string literal it was made from.
+     */
+    template <size_t N>
+    class StaticMarkup
+    {
+    public:
+        /** Parses and checks a string literal containing color codes */
+        constexpr explicit StaticMarkup(const char (&source)[N]);
+
+        // The text can grow (an escaped newline keeps "00") but can never
+        // be more than twice the source, and there are at most two color
+        // changes per source character
+        char text[2 * N];
+        MarkupEntry entries[2 * N + 1];
+        size_t count;
+
+    private:
+        constexpr void add_text(const char *first, size_t size);
+        constexpr void add_color(unsigned short fg, unsigned short bg);
+        size_t length;
+    };
+
+    /**
+     * Parses a string literal containing color codes at compile time.
+     * Every '&' must be followed by another '&' or by a color code that has
+     * text after it, otherwise compiling a constexpr use of this fails.
+     */
+    template <size_t N>
+    constexpr StaticMarkup<N> markup(const char (&source)[N]);
+#endif
+
+    /**
+     * While a RawMode object exists the terminal stays in unbuffered,
+     * echoless mode, and IO objects read all of the input that is waiting
+     * at once instead of switching modes for every key. When stdout is a
+     * terminal it is also asked to mark pastes (bracketed paste), so a
+     * paste reads as one Key even if it arrives between two reads. The
+     * terminal is put back the way it was when the RawMode object goes
+     * away, or if the program is killed by a signal (like Ctrl+C) while it
+     * exists.
+     */
+    class RawMode
+    {
+    public:
+        /** Puts the terminal in raw mode (sessions can be nested) */
+        TRIO_INLINE RawMode();
+        /** Puts the terminal back the way it was */
+        TRIO_INLINE ~RawMode();
+        /** Whether a RawMode session is active */
+        static TRIO_INLINE bool active();
+
+    private:
+        RawMode(const RawMode &);
+        RawMode &operator=(const RawMode &);
+    };
+
+    /**
+     * Codes for keys that don't type a character. They come after the last
+     * unicode code point, so they can't be mixed up with characters.
+     */
+    enum KeyCodes
+    {
+        KEY_UP = 0x110000,
+        KEY_DOWN,
+        KEY_RIGHT,
+        KEY_LEFT,
+        KEY_HOME,
+        KEY_END,
+        KEY_INSERT,
+        KEY_DELETE,
+        KEY_PAGE_UP,
+        KEY_PAGE_DOWN,
+        KEY_F1,
+        KEY_F2,
+        KEY_F3,
+        KEY_F4,
+        KEY_F5,
+        KEY_F6,
+        KEY_F7,
+        KEY_F8,
+        KEY_F9,
+        KEY_F10,
+        KEY_F11,
+        KEY_F12,
+        KEY_PASTE // Text pasted all at once, which is kept in Key::text
+    };
+
+    /** Keys that can be held down along with another key (combined with |) */
+    enum KeyModifiers
+    {
+        KEY_SHIFT = 1,
+        KEY_ALT = 2,
+        KEY_CTRL = 4
+    };
+
+    /**
+     * A single key read from the keyboard. The code is the unicode code
+     * point of the character that was typed, or one of the KeyCodes for
+     * keys like the arrows.
+     */
+    class Key
+    {
+    public:
+        unsigned int code;
+        // The KeyModifiers that were held down
+        unsigned int mods;
+        // The pasted text, when code is KEY_PASTE
+        string text;
+        /** Creates a Key */
+        TRIO_INLINE Key(const unsigned int &code = 0, const unsigned int &mods = 0);
+        /** A readable name for the key, like "a", "Enter" or "Ctrl+Up" */
+        TRIO_INLINE string name() const;
+    };
+
+    /**
+     * Timing collected by a FrameClock. Frame times are how long the program
+     * spent on each frame (from one tick() returning to the next tick()
+     * call), in milliseconds.
+     */
+    struct FrameStats
+    {
+        size_t frames;
+        /** Frames that weren't finished until after their deadline */
+        size_t missed;
+        /** Frames skipped entirely to catch back up after falling behind */
+        size_t dropped;
+        double min_ms;
+        double avg_ms;
+        /** 99% of recent frames were finished in this time or less */
+        double p99_ms;
+    };
+
+    /**
+     * A FrameClock keeps animation at a steady rate. Each tick() waits until
+     * the next frame's deadline, so time spent drawing is taken out of the
+     * wait instead of added to it. Deadlines are fixed steps from when the
+     * clock started, so the rate doesn't drift. If a frame runs long, the
+     * next one starts right away, and if the program falls a whole frame or
+     * more behind, those frames are dropped instead of rushed through.
+     */
+    class FrameClock
+    {
+    public:
+        /** Creates a FrameClock that ticks some number of times a second */
+        TRIO_INLINE FrameClock(double fps = 30);
+
+        /** Changes how many times a second the clock ticks */
+        TRIO_INLINE void set_fps(double fps);
+        /** How many times a second the clock ticks */
+        TRIO_INLINE double fps() const;
+
+        /**
+         * Waits for the next frame's deadline. Returns how many frames have
+         * passed, which is more than 1 when frames were dropped.
+         */
+        TRIO_INLINE unsigned int tick();
+
+        /** Timing for the frames so far */
+        TRIO_INLINE FrameStats stats() const;
+        /** Restarts the clock from now and forgets the timing so far */
+        TRIO_INLINE void reset();
+
+    private:
+        typedef std::chrono::steady_clock clock;
+        double rate;
+        clock::duration period;
+        clock::time_point deadline;
+        clock::time_point frame_start;
+        FrameStats totals;
+        double total_ms;
+        // The most recent frame times, for working out p99_ms
+        vector<float> recent;
+        size_t next_recent;
+    };
+
+    /**
+     * A Sink is where an IO object sends its output. TrIO has sinks for
+     * streams, file descriptors and memory, and other destinations can be
+     * added by overriding write().
+     */
+    class Sink
+    {
+    public:
+        TRIO_INLINE virtual ~Sink();
+        /** Sends some bytes on */
+        virtual void write(const char *text, size_t size) = 0;
+        /** Sends two runs of bytes on, one after the other */
+        TRIO_INLINE virtual void write(const char *first, size_t first_size, const char *second, size_t second_size);
+        /** Pushes out anything the Sink is holding on to */
+        TRIO_INLINE virtual void flush();
+        /**
+         * Gets the size of the terminal behind the Sink
+         * @return false if there is no terminal (or its size is unknown)
+         */
+        TRIO_INLINE virtual bool size(unsigned short &rows, unsigned short &cols);
+    };
+
+    /**
+     * A StreamSink sends output to a std::ostream, or to a std::wostream
+     * after converting it from UTF-8 to wide characters
+     */
+    class StreamSink : public Sink
+    {
+    public:
+        /** Sends output to a stream, which must outlive the StreamSink */
+        TRIO_INLINE explicit StreamSink(ostream &out);
+        /** Sends output to a wide stream, which must outlive the StreamSink */
+        TRIO_INLINE explicit StreamSink(wostream &wout);
+        TRIO_INLINE void write(const char *text, size_t size);
+        TRIO_INLINE void flush();
+        TRIO_INLINE bool size(unsigned short &rows, unsigned short &cols);
+
+    private:
+        ostream *out;
+        wostream *wout;
+    };
+
+    /**
+     * An FdSink writes output straight to a file descriptor (like a pipe, a
+     * file or a pseudo-terminal) with write() and writev(), without going
+     * through iostreams. The descriptor isn't closed by the FdSink.
+     */
+    class FdSink : public Sink
+    {
+    public:
+        /** Writes output to a file descriptor */
+        TRIO_INLINE explicit FdSink(int fd);
+        TRIO_INLINE void write(const char *text, size_t size);
+        TRIO_INLINE void write(const char *first, size_t first_size, const char *second, size_t second_size);
+        TRIO_INLINE bool size(unsigned short &rows, unsigned short &cols);
+
+    private:
+        int fd;
+    };
+
+    /**
+     * A MemorySink keeps output in memory, like a terminal that only records
+     * what it is sent. It is handy for tests, and for drawing something once
+     * and sending it elsewhere later.
+     */
+    class MemorySink : public Sink
+    {
+    public:
+        /**
+         * Creates an empty MemorySink. Giving it a size makes IO objects
+         * treat it as a terminal of that size.
+         */
+        TRIO_INLINE explicit MemorySink(unsigned short rows = 0, unsigned short cols = 0);
+        TRIO_INLINE void write(const char *text, size_t size);
+        TRIO_INLINE void write(const char *first, size_t first_size, const char *second, size_t second_size);
+        TRIO_INLINE bool size(unsigned short &rows, unsigned short &cols);
+        /** Everything that was sent since the MemorySink was made or cleared */
+        TRIO_INLINE const string &data() const;
+        /** Forgets what was sent, keeping the memory for reuse */
+        TRIO_INLINE void clear();
+
+    private:
+        string bytes;
+        unsigned short n_rows;
+        unsigned short n_cols;
+    };
+
+    /**
+     * A Recorder is a Sink that keeps a timed copy of everything written to
+     * it in a file, passing it on to another Sink as it goes. Recordings
+     * are asciicast v2 files (which asciinema can play too), and replay()
+     * plays them back. The file is written by a background thread from a
+     * ring buffer of bounded size, so recording costs little more than a
+     * copy.
+     */
+    class Recorder : public Sink
+    {
+    public:
+        /**
+         * Starts recording to a file. Output is passed on to forward too,
+         * unless it is NULL. The size is written in the recording's header.
+         */
+        TRIO_INLINE explicit Recorder(const string &path, Sink *forward = NULL, unsigned short rows = 0, unsigned short cols = 0, size_t capacity = 1 << 20);
+        /** Writes whatever is still waiting and closes the file */
+        TRIO_INLINE ~Recorder();
+        /** Whether the file could be opened (and written so far) */
+        TRIO_INLINE bool good() const;
+        /** The Sink output is passed on to, or NULL */
+        TRIO_INLINE Sink *target() const;
+        TRIO_INLINE void write(const char *text, size_t size);
+        TRIO_INLINE void write(const char *first, size_t first_size, const char *second, size_t second_size);
+        TRIO_INLINE void flush();
+        TRIO_INLINE bool size(unsigned short &rows, unsigned short &cols);
+
+    private:
+        Sink *forward;
+        std::unique_ptr<detail::RecordWriter> writer;
+        Recorder(const Recorder &);
+        Recorder &operator=(const Recorder &);
+    };
+
+    /**
+     * What replay() played back
+     */
+    struct ReplayStats
+    {
+        /** Chunks of output played */
+        size_t events;
+        /** Bytes of output played */
+        size_t bytes;
+        /** How long the recording took to make */
+        double recorded_ms;
+        /** How long it took to play back */
+        double played_ms;
+    };
+
+    /**
+     * Plays a recording made by a Recorder (or asciinema) back into a Sink.
+     * At speed 1 output comes out as fast as it was recorded, at speed 2
+     * twice as fast, and at speed 0 as fast as the Sink takes it.
+     * @return false if the recording couldn't be read
+     */
+    TRIO_INLINE bool replay(const string &path, Sink &sink, double speed = 1, ReplayStats *stats = NULL);
+
+    /**
+     * Counters kept by an IO object, to see what output and input cost.
+     * Counting is cheap, but defining TRIO_NO_STATS compiles it out, and
+     * then only colors_skipped is counted.
+     */
+    struct IOStats
+    {
+        /** Bytes sent to the terminal (after any buffering) */
+        size_t bytes_written;
+        /** Writes to the IO object's Sink */
+        size_t writes;
+        /**
+         * Calls to flush(), by the program or by the IO object itself (when
+         * the buffer fills up, or before waiting for input). Unbuffered
+         * output is written after every operation without flushing.
+         */
+        size_t flushes;
+        /** Color changes sent to the terminal (SGR escape sequences) */
+        size_t colors_sent;
+        /** Color changes that didn't need to be sent (see colors_skipped) */
+        size_t colors_skipped;
+        /** Cursor moves sent to the terminal */
+        size_t cursor_moves;
+        /** Color codes found while printing strings with markup in them */
+        size_t markup_segments;
+        /** Bytes read from the keyboard */
+        size_t input_bytes;
+        /** Time spent waiting for keys in operator>>, in milliseconds */
+        double input_wait_ms;
+    };
+
     /**
      * Main input/output control for the library. Can use various other objects to
      * print, colorize, get input, and various screen functions.
@@ -142,76 +714,777 @@ namespace trio
     {
     public:
         // constructors
-        inline IO();
-        inline IO(ostream &out);
-        inline IO(wostream &wout);
+        /** Prints to the terminal (stdout) */
+        TRIO_INLINE IO();
+        /** Prints to a stream, which must outlive the IO object */
+        TRIO_INLINE IO(ostream &out);
+        /** Prints to a wide stream, which must outlive the IO object */
+        TRIO_INLINE IO(wostream &wout);
+        /** Prints to a Sink, which must outlive the IO object */
+        TRIO_INLINE explicit IO(Sink &sink);
 
         // output operations
         /**
          * Prints a string to the terminal and interprets
          * any color codes found
          */
-        inline IO &operator<<(string text);
+        TRIO_INLINE IO &operator<<(const string &text);
+        /** Prints a string whose color codes were already parsed */
+        TRIO_INLINE IO &operator<<(const Markup &markup);
+#if defined(TRIO_CPP14)
+        /** Prints a string whose color codes were parsed at compile time */
+        template <size_t N>
+        inline IO &operator<<(const StaticMarkup<N> &markup);
+#endif
         /** Prints a character to the terminal */
-        inline IO &operator<<(const char &letter);
+        TRIO_INLINE IO &operator<<(const char &letter);
         /** Prints an integer to the terminal */
-        inline IO &operator<<(const int &number);
+        TRIO_INLINE IO &operator<<(const int &number);
         /** Prints a double to the terminal */
-        inline IO &operator<<(const double &number);
+        TRIO_INLINE IO &operator<<(const double &number);
 
         // special output operations
         /**
          * Moves the terminal's cursor to a row/column specified
          * by a Point object.
          */
-        inline IO &operator<<(const Point &point);
+        TRIO_INLINE IO &operator<<(const Point &point);
         /**
          * Changes the color of the terminal to the foreground and
          * background specified by the Color object.
          */
-        inline IO &operator<<(const Color &color);
+        TRIO_INLINE IO &operator<<(const Color &color);
+        /**
+         * Tells the IO object how many colors the terminal can show. Colors
+         * it can't show are sent as the closest one it can.
+         */
+        TRIO_INLINE IO &set_color_depth(ColorDepth depth);
+        /** How many colors the IO object thinks the terminal can show */
+        TRIO_INLINE ColorDepth color_depth() const;
         /**
          * Calls sleep_ms and returns IO object which allows us
          * to include waiting in output chains
          */
-        inline IO &sleep(int ms);
+        TRIO_INLINE IO &sleep(int ms);
+        /**
+         * Flushes and waits for a FrameClock's next tick, then returns the
+         * IO object so frames can be drawn at a steady rate in output chains
+         */
+        TRIO_INLINE IO &sleep(FrameClock &clock);
         /**
          * Calls clear_terminal and returns IO object which allows us
          * to include screen clearing in output chains
          */
-        inline IO &clear();
+        TRIO_INLINE IO &clear();
+
+        /**
+         * Prints text to the terminal exactly as given, without interpreting
+         * any color codes
+         */
+        TRIO_INLINE IO &write(const char *text, size_t size);
+
+        // terminal size
+        /** The number of rows the terminal has (0 if it can't be told) */
+        TRIO_INLINE unsigned short rows();
+        /** The number of columns the terminal has (0 if it can't be told) */
+        TRIO_INLINE unsigned short cols();
+        /**
+         * Whether the terminal changed size since the last time this was
+         * asked. Programs can check this every frame and lay out their
+         * screen again when it returns true.
+         */
+        TRIO_INLINE bool resized();
+        /**
+         * Turns culling on or off. While it is on (the default), Points
+         * outside of the terminal and the text printed after them send
+         * nothing, and the line printed after a Point is cut off at the
+         * terminal's right edge instead of wrapping. Lines after the
+         * Point's line wrap and scroll as usual.
+         */
+        TRIO_INLINE IO &set_culling(bool enabled);
+
+        // scrolling regions
+        /**
+         * Whether the terminal can scroll a range of its rows by itself. If
+         * it can't, the scrolling methods below do nothing and the rows have
+         * to be redrawn instead.
+         */
+        TRIO_INLINE bool can_scroll() const;
+        /**
+         * Whether the terminal can scroll the rows of an area by itself
+         * without touching anything outside of it. The terminal only
+         * scrolls whole rows, so the area must be as wide as the terminal.
+         */
+        TRIO_INLINE bool can_scroll(const Rect &area);
+        /** Allows or forbids scrolling by the terminal (to force redrawing) */
+        TRIO_INLINE IO &set_scrolling(bool enabled);
+        /**
+         * Limits scrolling to the rows from top to bottom (inclusive), so
+         * rows outside of them stay put. The cursor moves to the top left.
+         */
+        TRIO_INLINE IO &set_scroll_region(unsigned short top, unsigned short bottom);
+        /** Lets the whole terminal scroll again. The cursor moves to the top left. */
+        TRIO_INLINE IO &reset_scroll_region();
+        /**
+         * Scrolls the scroll region (or the whole terminal) up, leaving
+         * blank rows at its bottom
+         */
+        TRIO_INLINE IO &scroll_up(unsigned short lines = 1);
+        /**
+         * Scrolls the scroll region (or the whole terminal) down, leaving
+         * blank rows at its top
+         */
+        TRIO_INLINE IO &scroll_down(unsigned short lines = 1);
+
+        // buffered output
+        /**
+         * Turns buffered output on or off. While buffered, text, colors and
+         * cursor moves are collected in memory and sent to the terminal all
+         * at once by flush(), when more than limit bytes are waiting, or
+         * before waiting on input or sleeping.
+         */
+        TRIO_INLINE IO &set_buffered(bool enabled, size_t limit = 65536);
+        /** Whether output is being buffered */
+        TRIO_INLINE bool is_buffered() const;
+        /** Sends any buffered output to the terminal */
+        TRIO_INLINE IO &flush();
+        /** Sends any buffered output before the IO object goes away */
+        TRIO_INLINE ~IO();
+
+        // recording
+        /**
+         * Starts recording everything printed from here on to a file (see
+         * Recorder), while still printing it. Any recording already going
+         * is stopped first.
+         * @return false if the file couldn't be opened
+         */
+        TRIO_INLINE bool record(const string &path, size_t capacity = 1 << 20);
+        /** Stops recording and closes the recording's file */
+        TRIO_INLINE IO &stop_recording();
+
+        /**
+         * How many color changes were never sent to the terminal because
+         * they would not have changed anything
+         */
+        TRIO_INLINE size_t colors_skipped() const;
+        /** What this IO object has done since it was made (or reset) */
+        TRIO_INLINE IOStats stats() const;
+        /** Sets all of the statistics back to 0 */
+        TRIO_INLINE IO &reset_stats();
 
         // input operations
         /**
          * Gets a single character from stdin. Input is unbuffered, echoless,
-         * blocking. For non-blocking, use a separate thread.
+         * blocking. For non-blocking, use try_get().
+         */
+        TRIO_INLINE IO &operator>>(unsigned char &ch_var);
+        TRIO_INLINE IO &operator>>(char &ch_var);
+        /**
+         * Gets a single key from stdin (characters, arrow keys, function
+         * keys, pastes...). Input is unbuffered, echoless, blocking. For
+         * non-blocking, use try_get().
          */
-        inline IO &operator>>(unsigned char &ch_var);
-        inline IO &operator>>(char &ch_var);
+        TRIO_INLINE IO &operator>>(Key &key);
         /**
-         * Gets a single key from stdin (characters or arrow keys). Input is
-         * unbuffered, echoless, blocking. For non-blocking, use a separate
-         * thread.
+         * Gets a single key from stdin (characters or arrow keys) as text,
+         * which is the key's name (see Key::name) or what was pasted. Input
+         * is unbuffered, echoless, blocking. For non-blocking, use try_get().
          */
-        inline IO &operator>>(char *&str_var);
+        TRIO_INLINE IO &operator>>(char *&str_var);
+        /**
+         * Gets a key if one has been typed, without waiting. The first call
+         * starts reading the keyboard on a background thread, which keeps
+         * the terminal in raw mode until stop_input() is called or the IO
+         * object goes away.
+         * @return whether a key was read
+         */
+        TRIO_INLINE bool try_get(Key &key);
+        /**
+         * Waits up to ms milliseconds (forever if ms is negative) for a key
+         * to be typed, reading the keyboard on a background thread.
+         * @return whether a key was read before the time ran out
+         */
+        TRIO_INLINE bool get_for(Key &key, int ms);
+        /** Stops reading the keyboard in the background */
+        TRIO_INLINE IO &stop_input();
 
     private:
-        ostream *out;
-        wostream *wout;
-        bool wide;
-        inline void set_color(Color c);
+        // The background keyboard reader, if it has been started. It is
+        // shared so copies of an IO object read from the same thread.
+        std::shared_ptr<detail::InputReader> reader;
+        /** Starts the background keyboard reader if it isn't running */
+        TRIO_INLINE detail::InputReader &start_input();
+        // Input that has been read from the terminal but not used yet
+        unsigned char input_queue[256];
+        size_t input_head;
+        size_t input_size;
+        // The text of the last key read as a string
+        string key_text;
+        // The bytes of a key from the background reader, read one at a time
+        string key_bytes;
+        size_t key_head;
+        /** Reads all of the input that is waiting into the input queue */
+        TRIO_INLINE bool fill_input();
 
-#if defined(WINDOWS)
-        bool windows_setup;
+        // Where output goes. Sinks the IO object made itself are shared by
+        // its copies, like the keyboard reader.
+        std::shared_ptr<Sink> own_sink;
+        Sink *sink;
+        // Whether the sink is the Windows console, which is colored and
+        // moved around with API calls instead of escape sequences
+        bool console;
+        // The Recorder output goes through while recording
+        std::shared_ptr<Recorder> recorder;
+        /** Sets up everything but the sink */
+        TRIO_INLINE void init();
+        /** Sends text to the sink, along with everything buffered before it */
+        TRIO_INLINE void send(const char *text, size_t size);
+        // The color the terminal should have, and the color it really has
+        Color color_wanted;
+        Color color_applied;
+        bool color_pending;
+        bool color_known;
+        ColorDepth depth;
+        IOStats counters;
+        // How many of the background reader's bytes were counted already
+        size_t reader_bytes_counted;
+        TRIO_INLINE void set_color(Color c);
+        /** Sends the wanted color to the terminal if it really changed */
+        TRIO_INLINE void apply_color();
+        bool buffered;
+        size_t buffer_limit;
+        string buffer;
+        /** Sends text to the buffer, or big text to the sink */
+        TRIO_INLINE void put(const char *text, size_t size);
+        /** Sends printable text, applying the color and tracking the cursor */
+        TRIO_INLINE void put_text(const char *text, size_t size);
+        /** Sends only the parts of text printed after a Point that are visible */
+        TRIO_INLINE void put_visible(const char *text, size_t size);
+
+        // Where we believe the cursor is, so moves can be as short as possible
+        unsigned short cursor_row;
+        unsigned short cursor_col;
+        bool cursor_known;
+        // The terminal's size (0 if we can't tell) for knowing when text wraps
+        unsigned short term_rows;
+        unsigned short term_cols;
+        bool size_checked;
+        // How many resizes had happened when the size was last asked for
+        unsigned int size_resizes;
+        // The size the last time resized() was asked
+        bool size_seen;
+        unsigned short seen_rows;
+        unsigned short seen_cols;
+        // Where text printed after a Point lands, which can be off of the
+        // terminal, so it can be culled (see put_visible)
+        bool culling;
+        bool positioned;
+        unsigned int view_row;
+        unsigned int view_col;
+        // The rows the terminal scrolls, if they were limited, and whether
+        // the terminal may do the scrolling
+        unsigned short scroll_top;
+        unsigned short scroll_bottom;
+        bool scroll_set;
+        bool scrolling;
+        /** Moves the cursor using the shortest escape sequence available */
+        TRIO_INLINE void move_cursor(unsigned short row, unsigned short col);
+        /** Updates the cursor position after text has been printed */
+        TRIO_INLINE void advance_cursor(const char *text, size_t size);
+        /**
+         * Asks the terminal for its size the first time it is needed, and
+         * again after it was resized
+         */
+        TRIO_INLINE void check_size();
+        /** Finishes an output operation, flushing when appropriate */
+        TRIO_INLINE void end_output();
+        /** Prints already parsed markup */
+        TRIO_INLINE void print_entries(const char *text, const MarkupEntry *entries, size_t count);
+
+        /** Receives the results of scanning a string for color codes */
+        struct MarkupPrinter
+        {
+            IO &io;
+            TRIO_INLINE void text(const char *text, size_t size);
+            TRIO_INLINE void color(unsigned short fg, unsigned short bg);
+        };
+
+#if defined(WINDOWS)
+        bool windows_setup;
         HANDLE stdin_terminal;
         HANDLE stdout_terminal;
-        inline void setupWindows();
+        TRIO_INLINE void setupWindows();
 #endif
     };
+
+    /**
+     * A Cell is a single character position on a Screen. It holds one
+     * unicode code point along with the foreground and background color
+     * codes it should be drawn with. A wide character (see char_width)
+     * covers two Cells, and the one on the right holds 0.
+     */
+    class Cell
+    {
+    public:
+        unsigned int ch;
+        unsigned int fg;
+        unsigned int bg;
+        /** Creates a Cell */
+        TRIO_INLINE Cell(const unsigned int &ch = ' ', const unsigned int &fg = 0, const unsigned int &bg = 0);
+        TRIO_INLINE bool operator==(const Cell &other) const;
+        TRIO_INLINE bool operator!=(const Cell &other) const;
+    };
+
+    /**
+     * A Screen is a double-buffered grid of Cells. Drawing only changes the
+     * back grid. When present() is called the back grid is compared to the
+     * front grid (what is already on the terminal) and only the runs of
+     * cells that changed are sent to the IO object.
+     */
+    class Screen
+    {
+    public:
+        /** Creates a Screen with the given number of rows and columns */
+        TRIO_INLINE Screen(const unsigned short &rows, const unsigned short &cols);
+
+        /** The number of rows in the Screen */
+        TRIO_INLINE unsigned short rows() const;
+        /** The number of columns in the Screen */
+        TRIO_INLINE unsigned short cols() const;
+
+        /** Gets the back grid's Cell at a row/column */
+        TRIO_INLINE Cell &at(const unsigned short &row, const unsigned short &col);
+        /** Sets the back grid's Cell at a row/column */
+        TRIO_INLINE Screen &put(const unsigned short &row, const unsigned short &col, const Cell &cell);
+        /**
+         * Writes a (UTF-8) string into the back grid starting at a row/column
+         * using a single color. Wide characters take up two Cells. Text past
+         * the right edge is cut off.
+         */
+        TRIO_INLINE Screen &print(const unsigned short &row, const unsigned short &col, const string &text, const Color &color = Color(0, 0));
+        /** Fills the entire back grid with one Cell */
+        TRIO_INLINE Screen &fill(const Cell &cell = Cell());
+
+        /**
+         * Sends every Cell that differs between the back and front grids to
+         * the IO object, then makes the front grid match the back grid.
+         */
+        TRIO_INLINE void present(IO &io);
+        /**
+         * Like present(), but only compares the Cells inside some areas.
+         * Cells outside of them must not have changed since the last present.
+         */
+        TRIO_INLINE void present(IO &io, const vector<Rect> &areas);
+        /**
+         * Forgets what is on the terminal, so the next present() redraws
+         * every Cell.
+         */
+        TRIO_INLINE void invalidate();
+
+    private:
+        unsigned short n_rows;
+        unsigned short n_cols;
+        vector<Cell> front;
+        vector<Cell> back;
+        bool front_valid;
+        /** Sends the changed Cells between two columns of a row */
+        TRIO_INLINE void present_row(IO &io, unsigned short row, unsigned short first, unsigned short last, string &run, bool &colored);
+    };
+
+    class Compositor;
+
+    /**
+     * A Pane is a rectangular region of the terminal with its own grid of
+     * Cells, drawn by a Compositor. Panes can overlap: the one with the
+     * highest z is drawn on top. Text is printed with the usual color codes
+     * and is clipped to the Pane. Every change is recorded as a dirty
+     * rectangle, so only what changed has to be drawn again.
+     */
+    class Pane
+    {
+    public:
+        /** Creates a blank Pane covering an area of the terminal */
+        TRIO_INLINE explicit Pane(const Rect &area, const int &z = 0);
+        /** Takes the Pane off of its Compositor */
+        TRIO_INLINE ~Pane();
+
+        /** Where the Pane is on the terminal, and its size */
+        TRIO_INLINE const Rect &area() const;
+        /** Where the Pane is in the stack of Panes (higher is on top) */
+        TRIO_INLINE int z() const;
+        /** Whether the Pane is being shown */
+        TRIO_INLINE bool visible() const;
+        /** Moves the Pane's top left corner to a row/column */
+        TRIO_INLINE Pane &move(const unsigned short &row, const unsigned short &col);
+        /** Changes the Pane's size, keeping the Cells that still fit */
+        TRIO_INLINE Pane &resize(const unsigned short &rows, const unsigned short &cols);
+        /** Changes where the Pane is in the stack of Panes */
+        TRIO_INLINE Pane &set_z(const int &z);
+        /** Shows or hides the Pane */
+        TRIO_INLINE Pane &show(const bool &visible);
+
+        /** Gets the Cell at a row/column of the Pane */
+        TRIO_INLINE const Cell &at(const unsigned short &row, const unsigned short &col) const;
+        /** Sets the Cell at a row/column of the Pane */
+        TRIO_INLINE Pane &put(const unsigned short &row, const unsigned short &col, const Cell &cell);
+        /**
+         * Writes text with color codes into the Pane starting at a
+         * row/column. Each newline continues at the same column on the next
+         * row, and anything past the Pane's edges is cut off.
+         */
+        TRIO_INLINE Pane &print(const unsigned short &row, const unsigned short &col, const string &text, const Color &color = Color(0, 0));
+        /** Fills the whole Pane with one Cell */
+        TRIO_INLINE Pane &fill(const Cell &cell = Cell());
+
+        /** The areas of the Pane that changed since it was last drawn */
+        TRIO_INLINE const vector<Rect> &dirty() const;
+
+    private:
+        friend class Compositor;
+        Rect bounds;
+        int depth;
+        bool shown;
+        vector<Cell> cells;
+        vector<Rect> damage;
+        // How the Pane looked on the terminal the last time it was drawn
+        bool drawn;
+        Rect drawn_bounds;
+        int drawn_depth;
+        bool drawn_shown;
+        Compositor *owner;
+        /** Records that an area of the Pane changed */
+        TRIO_INLINE void mark(const Rect &changed);
+
+        /** Receives the results of scanning a string printed in the Pane */
+        struct PanePrinter
+        {
+            Pane &pane;
+            unsigned short row;
+            unsigned short col;
+            unsigned short start;
+            Color base;
+            Color current;
+            TRIO_INLINE void text(const char *text, size_t size);
+            TRIO_INLINE void color(unsigned short fg, unsigned short bg);
+        };
+        Pane(const Pane &);
+        Pane &operator=(const Pane &);
+    };
+
+    /**
+     * A Compositor stacks Panes on top of each other and draws them on a
+     * Screen. When presenting, only the areas that were damaged (dirty
+     * rectangles of the Panes, plus wherever a Pane was moved, resized,
+     * restacked, shown or hidden) are put back together, and only the Cells
+     * that really changed are sent to the terminal.
+     */
+    class Compositor
+    {
+    public:
+        /** Creates a Compositor for a terminal of some size */
+        TRIO_INLINE Compositor(const unsigned short &rows, const unsigned short &cols);
+        /** Lets go of all of the Panes */
+        TRIO_INLINE ~Compositor();
+
+        /** Adds a Pane, which must stay alive until it is removed */
+        TRIO_INLINE Compositor &add(Pane &pane);
+        /** Removes a Pane, clearing where it was at the next present */
+        TRIO_INLINE Compositor &remove(Pane &pane);
+
+        /** Draws everything that changed since the last present */
+        TRIO_INLINE void present(IO &io);
+        /**
+         * Forgets what is on the terminal, so the next present() redraws
+         * everything
+         */
+        TRIO_INLINE void invalidate();
+
+        /** The number of rows being composited */
+        TRIO_INLINE unsigned short rows() const;
+        /** The number of columns being composited */
+        TRIO_INLINE unsigned short cols() const;
+
+    private:
+        Screen screen;
+        vector<Pane *> panes;
+        vector<Rect> damage;
+        bool full_redraw;
+        /** Rebuilds an area of the Screen from the Panes covering it */
+        TRIO_INLINE void compose(const Rect &area, const vector<Pane *> &stack);
+        Compositor(const Compositor &);
+        Compositor &operator=(const Compositor &);
+    };
+
+    /**
+     * A LogTail shows the last lines of a log in an area of the terminal,
+     * like `tail -f`. Adding a line scrolls the area with the terminal's
+     * scroll region when it can, so only the new line is sent and the rows
+     * above and below the area stay untouched. Otherwise the whole area is
+     * redrawn. Lines can have color codes and are cut off at the area's
+     * right edge.
+     */
+    class LogTail
+    {
+    public:
+        /** Creates an empty LogTail covering an area of the terminal */
+        TRIO_INLINE explicit LogTail(const Rect &area);
+        /** Where the LogTail is on the terminal, and its size */
+        TRIO_INLINE const Rect &area() const;
+        /** Adds a line at the bottom, scrolling the rest up */
+        TRIO_INLINE void append(IO &io, const string &line);
+        /** Draws every line again (after the terminal was cleared, say) */
+        TRIO_INLINE void redraw(IO &io);
+
+    private:
+        Rect bounds;
+        // The lines being shown, oldest first starting at index first
+        vector<string> lines;
+        size_t first;
+        /** Draws one line on a row, blanking the rest of the row */
+        TRIO_INLINE void draw_line(IO &io, unsigned short row, const string &line, bool pad);
+    };
+
+    /**
+     * A VirtualTerminal is a Sink that acts like a terminal nobody can see.
+     * It reads the text and escape sequences an IO object sends and keeps
+     * the grid of Cells a real terminal would show, so a program can check
+     * what it drew without a terminal, or check that two ways of drawing
+     * leave the same screen behind. Like a terminal behind a tty, a newline
+     * also goes back to the first column.
+     */
+    class VirtualTerminal : public Sink
+    {
+    public:
+        /** Creates a blank VirtualTerminal */
+        TRIO_INLINE explicit VirtualTerminal(const unsigned short &rows = 24, const unsigned short &cols = 80);
+        TRIO_INLINE void write(const char *text, size_t size);
+        TRIO_INLINE bool size(unsigned short &rows, unsigned short &cols);
+        /** How many rows the VirtualTerminal has */
+        TRIO_INLINE unsigned short rows() const;
+        /** How many columns the VirtualTerminal has */
+        TRIO_INLINE unsigned short cols() const;
+        /** Gets the Cell at a row/column */
+        TRIO_INLINE const Cell &at(const unsigned short &row, const unsigned short &col) const;
+        /** The text on a row, without colors or the blanks at its end */
+        TRIO_INLINE string row_text(const unsigned short &row) const;
+        /** The text on every row (see row_text), one line per row */
+        TRIO_INLINE string text() const;
+        /** Where the cursor is */
+        TRIO_INLINE Point cursor() const;
+        /** The color text printed now would get */
+        TRIO_INLINE Color color() const;
+        /** How many escape sequences weren't understood (and were skipped) */
+        TRIO_INLINE size_t unknown() const;
+        /** Blanks the screen and forgets everything, like a new one */
+        TRIO_INLINE void reset();
+        /** Whether two VirtualTerminals show exactly the same Cells */
+        TRIO_INLINE bool operator==(const VirtualTerminal &other) const;
+        TRIO_INLINE bool operator!=(const VirtualTerminal &other) const;
+
+    private:
+        unsigned short n_rows;
+        unsigned short n_cols;
+        vector<Cell> cells;
+        unsigned short cursor_row;
+        unsigned short cursor_col;
+        // Set after printing in the last column: the next character wraps
+        // to the next row first
+        bool wrap_next;
+        unsigned short scroll_top;
+        unsigned short scroll_bottom;
+        unsigned int fg;
+        unsigned int bg;
+        size_t unknown_count;
+        // Where the parser is, since sequences can be split between writes
+        unsigned char state;
+        bool csi_ignored;
+        unsigned int params[16];
+        unsigned int param_count;
+        // The start of a UTF-8 character cut off by the end of a write
+        char partial[4];
+        unsigned char partial_size;
+        /** Handles a control character */
+        TRIO_INLINE void control(unsigned char ch);
+        /** Prints one character at the cursor */
+        TRIO_INLINE void print(unsigned int ch);
+        /** Moves down a row, scrolling at the bottom of the scroll region */
+        TRIO_INLINE void line_feed();
+        /** Moves the rows top to bottom up (or down, if lines < 0) */
+        TRIO_INLINE void scroll(unsigned short top, unsigned short bottom, int lines);
+        /** Blanks the Cells from first up to (not including) last */
+        TRIO_INLINE void erase(size_t first, size_t last);
+        /** Blanks the other half of a wide character about to be split */
+        TRIO_INLINE void unpair(unsigned short row, unsigned short col);
+        /** Carries out a finished control sequence */
+        TRIO_INLINE void run_csi(char final);
+        /** Carries out a color change (SGR) */
+        TRIO_INLINE void run_sgr();
+    };
+
+    /**
+     * A RenderThread lets many threads print through one IO object. Each
+     * print() queues a whole record (which may have color codes) without
+     * locking or waiting for the terminal, and a single thread prints the
+     * records in batches. Records never get mixed together, and one
+     * record's colors never carry over to the next. While a RenderThread
+     * exists, only it should use the IO object, and it must go away before
+     * the IO object does.
+     */
+    class RenderThread
+    {
+    public:
+        /** Starts a thread that prints queued records to io */
+        TRIO_INLINE explicit RenderThread(IO &io);
+        /** Prints everything still queued, then stops the thread */
+        TRIO_INLINE ~RenderThread();
+
+        /** Queues a record to be printed (safe to call from any thread) */
+        TRIO_INLINE void print(const string &record);
+        /** Queues a record to be printed at a row/column */
+        TRIO_INLINE void print(const Point &point, const string &record);
+        /**
+         * Waits until everything this thread queued so far (and everything
+         * queued before it) is on the terminal
+         */
+        TRIO_INLINE void flush();
+
+    private:
+        std::unique_ptr<detail::RenderQueue> queue;
+        RenderThread(const RenderThread &);
+        RenderThread &operator=(const RenderThread &);
+    };
 } // namespace trio
 // For compatibility with older TrIO programs
 namespace Term = trio;
 
+// Templates have to be seen by every file that uses them, so they are
+// defined here even when TrIO is compiled separately
+#if defined(TRIO_CPP14)
+/**
+ * Parses and checks a string literal containing color codes. This follows
+ * the same rules as detail::scan_markup, but is stricter: every '&' must be
+ * followed by another '&' or by a color code with text after it. Anything
+ * else throws, which is a compile error when evaluated in a constexpr.
+ * @param source the string literal to parse
+ */
+template <size_t N>
+constexpr trio::StaticMarkup<N>::StaticMarkup(const char (&source)[N])
+    : text{}, entries{}, count(0), length(0)
+{
+    // String literals end with '\0', which is not part of the markup
+    const size_t size = (N > 0 && source[N - 1] == '\0') ? N - 1 : N;
+    if (size == 0)
+        return;
+    size_t span = 0;
+    // A color code waits here until we know text follows it
+    bool pending = false;
+    unsigned short pending_fg = 0;
+    unsigned short pending_bg = 0;
+    for (size_t i = 0; i <= size; i++)
+    {
+        const bool at_end = i == size;
+        const bool newline = !at_end && source[i] == '\n';
+        const bool code = !at_end && source[i] == '&';
+        if (!at_end && !newline && !code)
+            continue;
+        // Print the text before this point
+        if (i > span)
+        {
+            if (pending)
+                add_color(pending_fg, pending_bg);
+            pending = false;
+            add_text(source + span, i - span);
+        }
+        if (code)
+        {
+            if (i + 1 < size && source[i + 1] == '&')
+            {
+                // Escaped '&', it becomes the start of the next span
+                span = i + 1;
+                i++;
+                continue;
+            }
+            if (i + 2 >= size || source[i + 1] < '0' || source[i + 1] > '8' || source[i + 2] < '0' || source[i + 2] > '8')
+                throw std::invalid_argument("TrIO markup: '&' must be followed by '&' or a color code 00-88");
+        }
+        // A new segment starts here, so the last one ends
+        if (pending)
+            throw std::invalid_argument("TrIO markup: color code has no text after it");
+        add_color(0, 0);
+        if (at_end)
+            break;
+        pending = true;
+        if (newline)
+        {
+            pending_fg = 0;
+            pending_bg = 0;
+            span = i;
+        }
+        else
+        {
+            pending_fg = source[i + 1] - '0';
+            pending_bg = source[i + 2] - '0';
+            span = i + 3;
+            i += 2;
+        }
+    }
+}
+
+/**
+ * Adds a span of text to the parsed markup
+ * @param first the characters to add
+ * @param size how many characters to add
+ */
+template <size_t N>
+constexpr void trio::StaticMarkup<N>::add_text(const char *first, size_t size)
+{
+    if (count == 0)
+        entries[count++] = MarkupEntry{false, 0, 0, 0, 0};
+    for (size_t i = 0; i < size; i++)
+        text[length++] = first[i];
+    entries[count - 1].length += size;
+}
+
+/**
+ * Adds a color change to the parsed markup
+ * @param fg color code for the foreground
+ * @param bg color code for the background
+ */
+template <size_t N>
+constexpr void trio::StaticMarkup<N>::add_color(unsigned short fg, unsigned short bg)
+{
+    entries[count++] = MarkupEntry{true, fg, bg, length, 0};
+}
+
+/**
+ * Parses a string literal containing color codes at compile time. Use it to
+ * initialize a constexpr variable so mistakes are caught by the compiler:
+ *     constexpr auto title = trio::markup("&28Title\n");
+ * @param source the string literal to parse
+ * @return the parsed markup, ready to be printed with an IO object
+ */
+template <size_t N>
+constexpr trio::StaticMarkup<N> trio::markup(const char (&source)[N])
+{
+    return StaticMarkup<N>(source);
+}
+#endif
+
+#if defined(TRIO_CPP14)
+/**
+ * Prints a string whose color codes were parsed at compile time
+ * @param markup the parsed string to print to the terminal
+ * @return a reference to this IO object, to account for chained outputs
+ */
+template <size_t N>
+trio::IO &trio::IO::operator<<(const StaticMarkup<N> &markup)
+{
+    print_entries(markup.text, markup.entries, markup.count);
+    end_output();
+    return *this;
+}
+#endif
+
 /* ██╗███╗   ███╗██████╗ ██╗     ███████╗███╗   ███╗███████╗███╗   ██╗████████╗ █████╗ ████████╗██╗ ██████╗ ███╗   ██╗███████╗
  * ██║████╗ ████║██╔══██╗██║     ██╔════╝████╗ ████║██╔════╝████╗  ██║╚══██╔══╝██╔══██╗╚══██╔══╝██║██╔═══██╗████╗  ██║██╔════╝
  * ██║██╔████╔██║██████╔╝██║     █████╗  ██╔████╔██║█████╗  ██╔██╗ ██║   ██║   ███████║   ██║   ██║██║   ██║██╔██╗ ██║███████╗
@@ -222,6 +1495,389 @@ namespace Term = trio;
  * http://patorjk.com/software/taag/
 */
 
+#if !defined(TRIO_SEPARATE_COMPILATION) || defined(TRIO_IMPLEMENTATION)
+// The rest of the includes are only needed by the implementation
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <regex>
+#include <thread>
+
+// Include only for Windows
+#if defined(WINDOWS)
+#include <errno.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+// Include only for *nix
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <termios.h>
+#endif
+
+// SIMD is used to speed up scanning strings for color codes. SSE2 is always
+// available on x86-64, AVX2 is chosen at runtime (GCC and Clang only).
+// Define TRIO_NO_SIMD to always use the plain scalar code.
+#if !defined(TRIO_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRIO_SSE2 true
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TRIO_AVX2 true
+#include <immintrin.h>
+#endif
+#endif
+#endif
+
+// IO statistics are cheap to count, but defining TRIO_NO_STATS leaves the
+// counting out entirely
+#if defined(TRIO_NO_STATS)
+#define TRIO_STAT(counting)
+#else
+#define TRIO_STAT(counting) counting
+#endif
+
+namespace trio
+{
+    namespace detail
+    {
+        /** Adds the time until it goes away to a total, for IO statistics */
+        class StatTimer
+        {
+        public:
+            inline explicit StatTimer(double &total_ms)
+                : total_ms(total_ms), start(std::chrono::steady_clock::now()) {}
+            inline ~StatTimer()
+            {
+                total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+
+        private:
+            double &total_ms;
+            std::chrono::steady_clock::time_point start;
+        };
+
+        /**
+         * A fixed size ring buffer that one thread pushes into while another
+         * thread pops from it, without any locks. Capacity must be a power
+         * of two.
+         */
+        template <class T, size_t Capacity>
+        class SpscQueue
+        {
+        public:
+            inline SpscQueue();
+            /** Adds an item (producer only), false if the queue is full */
+            inline bool push(const T &item);
+            /** Takes the oldest item (consumer only), false if empty */
+            inline bool pop(T &item);
+            /** Whether there is nothing to pop */
+            inline bool empty() const;
+
+        private:
+            T slots[Capacity];
+            // Kept on separate cache lines so the two threads don't fight
+            alignas(64) std::atomic<size_t> head;
+            alignas(64) std::atomic<size_t> tail;
+        };
+
+        /**
+         * Turns the bytes a terminal sends into Keys. Escape sequences (in
+         * the xterm, VT and Linux console forms, with modifiers) are matched
+         * by a small state machine, and a bracketed paste becomes one Key.
+         */
+        class KeyDecoder
+        {
+        public:
+            inline KeyDecoder();
+            /** Adds bytes read from the terminal */
+            inline void feed(const unsigned char *bytes, size_t size);
+            /**
+             * Decodes the next key. Bytes that could be the start of a longer
+             * sequence (like a lone ESC) are held back unless timed_out is set.
+             */
+            inline bool next(Key &key, bool timed_out);
+            /** Whether bytes are being held back to see what follows them */
+            inline bool partial() const;
+            /** The bytes that haven't been decoded yet */
+            inline string rest() const;
+
+        private:
+            enum Result
+            {
+                INCOMPLETE,
+                COMPLETE,
+                SKIPPED,
+                PASTE_START
+            };
+            string pending;
+            size_t start;
+            bool pasting;
+            size_t paste_scanned;
+            /** Decodes the key starting at pos, moving pos past it */
+            inline Result decode(size_t &pos, Key &key, bool timed_out) const;
+            /** Decodes a sequence starting with ESC [ */
+            inline Result decode_csi(size_t &pos, Key &key, bool timed_out) const;
+            /** Decodes a sequence starting with ESC O */
+            inline Result decode_ss3(size_t &pos, Key &key, bool timed_out) const;
+        };
+
+        // How long to wait after an ESC to see if a sequence follows it
+        const int escape_timeout_ms = 50;
+
+#if defined(WINDOWS)
+        // An event that stops a keyboard read, or NULL
+        typedef HANDLE StopSignal;
+        const StopSignal no_stop = NULL;
+        /** Adds the bytes a terminal would send for a console key event */
+        inline void console_key(const KEY_EVENT_RECORD &event, string &bytes);
+#else
+        // The read end of a pipe that stops a keyboard read, or -1
+        typedef int StopSignal;
+        const StopSignal no_stop = -1;
+#endif
+
+        /**
+         * Waits up to ms milliseconds (forever if negative) for keyboard
+         * input and reads it. Returns how many bytes were read, 0 at the end
+         * of input or when stop is signaled, or -1 if the time ran out.
+         */
+        inline long read_keyboard(unsigned char *bytes, size_t size, int ms, StopSignal stop);
+
+        /** Adds the bytes a terminal sends for a key */
+        inline void key_bytes(const Key &key, string &bytes);
+
+        /**
+         * Reads the keyboard on a background thread while the terminal is
+         * kept in raw mode, and queues up the keys for an IO object.
+         */
+        class InputReader
+        {
+        public:
+            /** Starts the reading thread */
+            inline InputReader();
+            /** Stops the reading thread and restores the terminal */
+            inline ~InputReader();
+            /** Takes a key without waiting, false if none is waiting */
+            inline bool try_get(Key &key);
+            /** Waits up to ms milliseconds (forever if negative) for a key */
+            inline bool get_for(Key &key, int ms);
+            /** How many bytes have been read from the keyboard */
+            inline size_t bytes_read() const;
+
+        private:
+            RawMode raw;
+            SpscQueue<Key, 1024> keys;
+            std::atomic<bool> stopping;
+            std::atomic<bool> finished;
+            std::atomic<size_t> total_bytes;
+            // Only used when the reader has to wake up a waiting consumer
+            std::atomic<bool> waiting;
+            std::mutex wait_mutex;
+            std::condition_variable wakeup;
+#if defined(WINDOWS)
+            HANDLE stop_event;
+#else
+            int stop_pipe[2];
+#endif
+            std::thread thread;
+            /** The body of the reading thread */
+            inline void run();
+            /** Queues a key, waiting for room if the consumer is behind */
+            inline void deliver(const Key &key);
+        };
+
+        /**
+         * An unbounded queue that any number of threads push into while one
+         * thread pops from it. Pushing never waits: each item gets its own
+         * node, which is linked in with a single atomic exchange.
+         */
+        template <class T>
+        class MpscQueue
+        {
+        public:
+            inline MpscQueue();
+            inline ~MpscQueue();
+            /** Adds an item (any thread) */
+            inline void push(T &&item);
+            /**
+             * Takes the oldest item (consumer only), false if empty or if the
+             * next item is only halfway pushed
+             */
+            inline bool pop(T &item);
+
+        private:
+            struct Node
+            {
+                std::atomic<Node *> next;
+                T item;
+            };
+            // Producers link new nodes after head, the consumer pops at tail.
+            // Padding keeps them on separate cache lines without needing an
+            // over-aligned allocation (which C++11's new doesn't support).
+            std::atomic<Node *> head;
+            char padding[64 - sizeof(std::atomic<Node *>)];
+            Node *tail;
+            MpscQueue(const MpscQueue &);
+            MpscQueue &operator=(const MpscQueue &);
+        };
+
+        /**
+         * Writes UTF-8 text into one row of Cells the way Screen::print
+         * does, returning the column after the last Cell written
+         */
+        inline unsigned short print_cells(Cell *row, unsigned short cols, unsigned short col, const char *text, size_t size, const Color &color);
+
+        // Color codes above the TrIO ones: palette entries and 24-bit colors
+        static const unsigned int palette_code = 0x100;
+        static const unsigned int rgb_code = 0x1000000;
+
+        /** The closest color code a terminal with some depth can show */
+        inline unsigned int fit_color(unsigned int code, ColorDepth depth);
+        /** The closest entry of the 256 color palette to a 24-bit color */
+        inline unsigned char nearest_palette(unsigned int rgb);
+        /** Writes the SGR parameters for a color code, returning the end */
+        inline char *put_sgr(char *out, unsigned int code, bool background);
+
+        /**
+         * Cuts text with color codes off after some number of columns,
+         * keeping its color codes. The text's width is stored in width.
+         */
+        inline string clip_markup(const string &text, unsigned short cols, unsigned short &width);
+
+        /**
+         * Where a VirtualTerminal's parser is: in text, after an ESC, in a
+         * control sequence (ESC [), or in a string it skips (like ESC ]),
+         * possibly at the ESC that ends it
+         */
+        enum TerminalState
+        {
+            TERMINAL_TEXT,
+            TERMINAL_ESCAPE,
+            TERMINAL_CSI,
+            TERMINAL_STRING,
+            TERMINAL_STRING_ESCAPE
+        };
+
+        /** One record queued for a RenderThread */
+        struct RenderRecord
+        {
+            bool move;
+            unsigned short row;
+            unsigned short col;
+            string text;
+        };
+
+        /**
+         * The state shared by a RenderThread's producers and the thread that
+         * prints for them
+         */
+        class RenderQueue
+        {
+        public:
+            /** Starts the printing thread */
+            inline explicit RenderQueue(IO &io);
+            /** Prints what is left and stops the printing thread */
+            inline ~RenderQueue();
+            /** Queues a record without waiting */
+            inline void push(RenderRecord &&record);
+            /** Waits until every record queued so far has been printed */
+            inline void wait_printed();
+
+        private:
+            IO &io;
+            bool was_buffered;
+            MpscQueue<RenderRecord> records;
+            std::atomic<size_t> queued;
+            std::atomic<size_t> printed;
+            std::atomic<bool> stopping;
+            // Only used when the printing thread has to be woken up
+            std::atomic<bool> waiting;
+            std::mutex wait_mutex;
+            std::condition_variable wakeup;
+            std::condition_variable done;
+            std::thread thread;
+            /** The body of the printing thread */
+            inline void run();
+        };
+
+        /**
+         * The file a Recorder writes to, and the thread that writes it from
+         * a ring buffer
+         */
+        class RecordWriter
+        {
+        public:
+            /** Starts the writing thread */
+            inline RecordWriter(FILE *file, size_t capacity);
+            /** Writes what is left, stops the writing thread and closes the file */
+            inline ~RecordWriter();
+            /** Records a chunk of output (given in two pieces) as one event */
+            inline void record(const char *first, size_t first_size, const char *second, size_t second_size);
+            /** Whether everything so far was written */
+            inline bool good() const;
+
+        private:
+            FILE *file;
+            std::chrono::steady_clock::time_point start;
+            // The event being put together, the output it is made from, and
+            // the start of a UTF-8 character cut off by the last chunk
+            string event;
+            string text;
+            string carry;
+            // Events waiting to be written. The writing thread only touches
+            // the used part, so it writes without holding the lock.
+            std::vector<char> ring;
+            size_t head;
+            size_t used;
+            bool stopping;
+            std::atomic<bool> failed;
+            std::mutex mutex;
+            std::condition_variable filled;
+            std::condition_variable drained;
+            std::thread thread;
+            /** Copies bytes into the ring, waiting for room when it is full */
+            inline void put(const char *data, size_t size);
+            /** The body of the writing thread */
+            inline void run();
+        };
+
+        /**
+         * Adds text to a JSON string, escaped. A UTF-8 character cut off by
+         * the end of the text is left out, and the number of bytes used is
+         * returned so the rest can be added later.
+         */
+        inline size_t append_json(string &out, const char *text, size_t size);
+        /**
+         * Reads a JSON string starting at pos (at its opening quote) into
+         * out, moving pos past it
+         */
+        inline bool read_json(const char *&pos, const char *end, string &out);
+        /** Reads a line (with its newline) from a file */
+        inline bool read_line(FILE *file, string &line);
+        /** Adds a code point to a string as UTF-8 */
+        inline void append_utf8(string &out, unsigned int code_point);
+
+        /**
+         * Compiles a regular expression, reusing the ones compiled most
+         * recently on this thread
+         */
+        inline const std::regex &cached_regex(const string &pattern);
+    } // namespace detail
+} // namespace trio
+
 /* dP     dP           dP                                 88888888b                              dP   oo                            
  * 88     88           88                                 88                                     88                                 
  * 88aaaaa88a .d8888b. 88  88d888b. .d8888b. 88d888b.    a88aaaa    dP    dP 88d888b. .d8888b. d8888P dP .d8888b. 88d888b. .d8888b. 
@@ -235,726 +1891,6637 @@ namespace Term = trio;
  */
 
 /**
- * Fuses two multi-line string together for printing side-by-side
- * @param left the string that will be on the left half of the fused string
- * @param right the string that will be on the right half of the fused string
- * @param pad bool, whether to pad each line of the string to be the same width
+ * Checks whether a code point falls in one of a sorted list of ranges
+ * @param code_point the code point to look for
+ * @param ranges the first and last code point of each range
+ * @param count how many ranges there are
+ * @return true if the code point is in a range
+ */
+bool trio::detail::in_ranges(unsigned int code_point, const unsigned int (*ranges)[2], size_t count)
+{
+    if (code_point < ranges[0][0] || code_point > ranges[count - 1][1])
+        return false;
+    size_t low = 0;
+    size_t high = count;
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        if (code_point > ranges[mid][1])
+            low = mid + 1;
+        else if (code_point < ranges[mid][0])
+            high = mid;
+        else
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Measures text that has no color codes in it. Runs of printable ASCII are
+ * counted eight bytes at a time.
+ * @param text the text to measure
+ * @param size the length of the text in bytes
+ * @return the width of the text in columns
+ */
+size_t trio::detail::plain_width(const char *text, size_t size)
+{
+    const unsigned long long ones = 0x0101010101010101ULL;
+    const unsigned long long highs = 0x8080808080808080ULL;
+    size_t width = 0;
+    size_t pos = 0;
+    while (pos < size)
+    {
+        if (pos + 8 <= size)
+        {
+            unsigned long long word;
+            memcpy(&word, text + pos, 8);
+            // Any byte below a space, above '~', or not ASCII at all
+            unsigned long long below = (word - ones * 0x20) & ~word & highs;
+            unsigned long long above = ((word + ones * (0x7F - 0x7E)) | word) & highs;
+            if ((below | above) == 0)
+            {
+                width += 8;
+                pos += 8;
+                continue;
+            }
+        }
+        unsigned char ch = (unsigned char)text[pos];
+        if (ch < 0x80)
+        {
+            width += ch >= 0x20 && ch < 0x7F;
+            pos++;
+        }
+        else
+            width += char_width(utf8_next(text, size, pos));
+    }
+    return width;
+}
+
+/**
+ * Measures a line of text that may have color codes in it. Lines with
+ * non-ASCII characters take the longest to measure, so their widths are
+ * remembered in a small cache (one per thread) and panels that are fused
+ * over and over aren't measured again.
+ * @param text the line to measure, which has no newlines
+ * @param size the length of the line in bytes
+ * @return the width of the line in columns
+ */
+size_t trio::detail::line_width(const char *text, size_t size)
+{
+    // Receives the text of the line between color codes, and measures it
+    struct WidthCounter
+    {
+        size_t width;
+        void text(const char *text, size_t size)
+        {
+            width += plain_width(text, size);
+        }
+        void color(unsigned short, unsigned short)
+        {
+        }
+    };
+    struct CacheEntry
+    {
+        string line;
+        size_t width;
+    };
+    static thread_local CacheEntry cache[64];
+    // Very long lines aren't worth copying into the cache
+    static const size_t longest_cached = 512;
+
+    bool ascii = true;
+    for (size_t i = 0; i < size && ascii; i++)
+        ascii = (unsigned char)text[i] < 0x80;
+    CacheEntry *entry = 0;
+    if (!ascii && size <= longest_cached)
+    {
+        // FNV-1a picks the slot
+        unsigned int hash = 2166136261u;
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+        entry = &cache[hash % 64];
+        if (entry->line.size() == size && memcmp(entry->line.data(), text, size) == 0)
+            return entry->width;
+    }
+    WidthCounter counter = {0};
+    scan_markup(text, size, counter);
+    if (entry)
+    {
+        entry->line.assign(text, size);
+        entry->width = counter.width;
+    }
+    return counter.width;
+}
+
+/**
+ * Splits text at every delim character. Like the regular expression split
+ * it replaces, a delimiter at the very end doesn't start another piece
+ * (unless the delimiter is included), but empty text is still one (empty)
+ * piece.
+ * @param text the text to split
+ * @param size the length of the text
+ * @param delim the character to split at
+ * @param include whether each piece after the first starts with the
+ * delimiter in front of it
+ * @param add called with the start and length of each piece, in order
+ */
+template <class Add>
+void trio::detail::split_char(const char *text, size_t size, char delim, bool include, Add add)
+{
+    const char *last = text + size;
+    const char *piece = text;
+    const char *field = text;
+    while (true)
+    {
+        const char *found = (const char *)memchr(field, delim, last - field);
+        if (!found)
+        {
+            if (field != last || piece == text || include)
+                add(piece, last - piece);
+            return;
+        }
+        add(piece, found - piece);
+        field = found + 1;
+        piece = include ? found : field;
+    }
+}
+
+/**
+ * Finds the lines of a string without copying them. Like split(text, '\n'),
+ * a newline at the very end doesn't start another line, but an empty
+ * string is still one (empty) line.
+ * @param text the string to find the lines of
+ * @param lines the vector to add the lines to
+ */
+void trio::detail::split_lines(const string &text, vector<LineSpan> &lines)
+{
+    split_char(text.data(), text.size(), '\n', false, [&lines](const char *line, size_t size) {
+        LineSpan span = {line, size, 0};
+        lines.push_back(span);
+    });
+}
+
+/**
+ * Compiles a regular expression. Compiling is far slower than matching, so
+ * the last few patterns used on each thread are kept, and the one used
+ * longest ago is dropped to make room for a new one.
+ * @param pattern the regular expression
+ * @return the compiled regular expression, valid until the next call on
+ * the same thread
+ */
+const std::regex &trio::detail::cached_regex(const string &pattern)
+{
+    static const size_t capacity = 8;
+    static thread_local std::vector<std::pair<string, std::regex>> cache;
+    for (size_t i = 0; i < cache.size(); i++)
+    {
+        if (cache[i].first == pattern)
+        {
+            // Move it to the front, where the newest patterns are
+            std::rotate(cache.begin(), cache.begin() + i, cache.begin() + i + 1);
+            return cache[0].second;
+        }
+    }
+    // Compile before touching the cache, in case the pattern is invalid
+    std::regex compiled(pattern);
+    if (cache.size() == capacity)
+        cache.pop_back();
+    cache.insert(cache.begin(), std::make_pair(pattern, std::move(compiled)));
+    return cache[0].second;
+}
+
+/**
+ * Fuses panels onto the lines of base. Each panel is split once, and the
+ * widths that fusing them one at a time would pad to are worked out ahead
+ * of time, so the result is built in a single pass.
+ * @param base the string that will be on the left, or null to start with
+ * no lines at all
+ * @param panels the strings to fuse onto it, left to right
+ * @param count how many panels there are
+ * @param pad whether to pad the lines like fuse(left, right, true) does
+ * @return the fused string
+ */
+std::string trio::detail::fuse_panels(const string *base, const string *panels, size_t count, bool pad)
+{
+    vector<LineSpan> base_lines;
+    if (base)
+        split_lines(*base, base_lines);
+    vector<vector<LineSpan>> lines(count);
+    size_t rows = base_lines.size();
+    for (size_t i = 0; i < count; i++)
+    {
+        split_lines(panels[i], lines[i]);
+        rows = std::max(rows, lines[i].size());
+    }
+
+    // When padding, each step pads the lines fused so far and the new
+    // panel's lines to the width of the widest line of either. Widths are
+    // what the terminal shows, so color codes and wide characters line up.
+    vector<size_t> widths(count, 0);
+    size_t width = 0;
+    size_t total = rows + (base ? base->size() : 0);
+    for (size_t i = 0; i < count; i++)
+        total += panels[i].size();
+    if (pad)
+    {
+        for (size_t l = 0; l < base_lines.size(); l++)
+        {
+            base_lines[l].width = line_width(base_lines[l].text, base_lines[l].size);
+            width = std::max(width, base_lines[l].width);
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            for (size_t l = 0; l < lines[i].size(); l++)
+            {
+                lines[i][l].width = line_width(lines[i][l].text, lines[i][l].size);
+                widths[i] = std::max(widths[i], lines[i][l].width);
+            }
+            widths[i] = std::max(widths[i], width);
+            width = 2 * widths[i];
+        }
+        // There can't be more padding than the width of every row
+        total += rows * width;
+    }
+
+    string result;
+    result.reserve(total);
+    for (size_t row = 0; row < rows; row++)
+    {
+        size_t row_width = 0;
+        if (row < base_lines.size())
+        {
+            result.append(base_lines[row].text, base_lines[row].size);
+            row_width = base_lines[row].width;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            const LineSpan *line = row < lines[i].size() ? &lines[i][row] : 0;
+            if (pad)
+                result.append(widths[i] - row_width, ' ');
+            if (line)
+                result.append(line->text, line->size);
+            if (pad)
+            {
+                result.append(widths[i] - (line ? line->width : 0), ' ');
+                row_width = 2 * widths[i];
+            }
+        }
+        result += '\n';
+    }
+    return result;
+}
+
+/**
+ * Fuses two multi-line string together for printing side-by-side
+ * @param left the string that will be on the left half of the fused string
+ * @param right the string that will be on the right half of the fused string
+ * @param pad bool, whether to pad each line of the string to be the same width
+ */
+std::string trio::fuse(const string &left, const string &right, bool pad)
+{
+    return detail::fuse_panels(&left, &right, 1, pad);
+}
+
+/**
+ * Fuses multiple multi-line strings together for printing side-by-side.
+ * @param strings an initializer list of strings to fuse, left to right
+ * Initializer lists look like: {myStrVar, "Hello", "test", other_string_var}
+ * @param pad bool, whether to pad each line of the string to be the same width
+ */
+std::string trio::fuse(std::initializer_list<string> strings, bool pad)
+{
+    // Gives the same result as fusing each string onto an empty one in turn
+    return detail::fuse_panels(0, strings.begin(), strings.size(), pad);
+}
+
+/**
+ * Fuses multiple multi-line strings together for printing side-by-side.
+ * @param strings a vector of strings ordered left to right
+ * @param pad bool, whether to pad each line of the string to be the same width
+ */
+std::string trio::fuse(const std::vector<string> &strings, bool pad)
+{
+    // Gives the same result as fusing each string onto an empty one in turn
+    return detail::fuse_panels(0, strings.data(), strings.size(), pad);
+}
+
+/**
+ * Split a string and store each new substring in a vector.
+ * @param text the original string
+ * @param delim the delimiting character to split by
+ * @param include determines if the delimeter should be included in the
+ * returned substrings
+ * @return vector containing each substring
+ */
+std::vector<std::string> trio::split(const string &text, char delim, bool include)
+{
+    vector<string> elems;
+    detail::split_char(text.data(), text.size(), delim, include, [&elems](const char *piece, size_t size) {
+        elems.push_back(string(piece, size));
+    });
+    return elems;
+}
+
+#if defined(TRIO_CPP17)
+/**
+ * Split a string without copying any of it. Each substring is a view into
+ * the original text.
+ * @param text the original string, which must outlive the substrings
+ * @param delim the delimiting character to split by
+ * @param include determines if the delimeter should be included in the
+ * returned substrings
+ * @return vector containing each substring
+ */
+std::vector<std::string_view> trio::split_view(std::string_view text, char delim, bool include)
+{
+    vector<std::string_view> elems;
+    detail::split_char(text.data(), text.size(), delim, include, [&elems](const char *piece, size_t size) {
+        elems.push_back(std::string_view(piece, size));
+    });
+    return elems;
+}
+#endif
+
+/**
+ * Split a string, using a regular expression as a delimeter, and store
+ * each new substring in a vector.
+ * Part of the rsplit() implementation came from Stack Overflow user Marcin,
+ * see the following post:
+ * https://stackoverflow.com/questions/16749069/c-split-string-by-regex
+ * @param text the original string
+ * @param delim the regular expression to match and split by
+ * @param include determines if the delimeter should be included in the
+ * returned substrings
+ * @return vector containing each substring
+ */
+std::vector<std::string> trio::rsplit(const string &text, const string &delim, bool include)
+{
+    std::vector<std::string> elems;
+    const std::regex &rgx = detail::cached_regex(delim);
+    // Find parts of the string which do not match the regexp and append them
+    // to the vector
+    // code -1 at the end means find everything but the rgx string (delimeter)
+    std::sregex_token_iterator iter(text.begin(), text.end(), rgx, -1);
+    std::sregex_token_iterator end;
+    while (iter != end)
+    {
+        elems.push_back(*(iter));
+        ++iter;
+    }
+
+    // If we want to include the delimeter, then we need to go re-add it to
+    // the beginning of each line.
+    if (include)
+    {
+        // code 0 at the end means find instances of the rgx string (delimeter)
+        std::sregex_token_iterator iter(text.begin(), text.end(), rgx, 0);
+        std::sregex_token_iterator end;
+
+        size_t i = 0;
+        while (iter != end)
+        {
+            // We are inserting the delimiter at the start
+            // of the NEXT string in the vector. A delimiter at the very end
+            // has no string after it, so it becomes one of its own.
+            if (i + 1 == elems.size())
+                elems.push_back("");
+            elems[i + 1].insert(0, iter->str());
+            // the iterator moves forward
+            ++iter;
+            // increment elems index
+            i++;
+        }
+    }
+
+    return elems;
+}
+
+/**
+ * Replaces all instances of a substring in a text with a new string.
+ * @param text the main text to replace in
+ * @param from the substring to replace
+ * @param to the new string to replace it with
+ * @return the updated main string
+ */
+std::string trio::replace_all(string text, string from, string to)
+{
+    size_t start_pos = 0;
+    // While we can find the substring "from"
+    // (start position changes each time we make a replacement)
+    while ((start_pos = text.find(from, start_pos)) != string::npos)
+    {
+        // Make the replacement
+        text.replace(start_pos, from.length(), to);
+        // Move past the string replacement's length, we don't need to
+        // check it
+        start_pos += to.length();
+    }
+    return text;
+}
+
+/**
+ * Appends the UTF-8 encoding of a unicode code point to a string.
+ * @param text the string to append to
+ * @param code_point the unicode code point to encode
+ */
+void trio::utf8_append(string &text, unsigned int code_point)
+{
+    // Code points outside of unicode (or surrogates) become U+FFFD
+    if (code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF))
+        code_point = 0xFFFD;
+    if (code_point < 0x80)
+    {
+        text += char(code_point);
+    }
+    else if (code_point < 0x800)
+    {
+        text += char(0xC0 | (code_point >> 6));
+        text += char(0x80 | (code_point & 0x3F));
+    }
+    else if (code_point < 0x10000)
+    {
+        text += char(0xE0 | (code_point >> 12));
+        text += char(0x80 | ((code_point >> 6) & 0x3F));
+        text += char(0x80 | (code_point & 0x3F));
+    }
+    else
+    {
+        text += char(0xF0 | (code_point >> 18));
+        text += char(0x80 | ((code_point >> 12) & 0x3F));
+        text += char(0x80 | ((code_point >> 6) & 0x3F));
+        text += char(0x80 | (code_point & 0x3F));
+    }
+}
+
+/**
+ * Decodes the unicode code point starting at pos in some UTF-8 text and
+ * moves pos past it. Invalid bytes decode to U+FFFD and only consume a
+ * single byte, so decoding always makes progress.
+ * @param text the UTF-8 text
+ * @param size the number of bytes in the text
+ * @param pos the position to decode at, moved to the next code point
+ * @return the decoded code point
+ */
+unsigned int trio::utf8_next(const char *text, size_t size, size_t &pos)
+{
+    unsigned char lead = (unsigned char)text[pos];
+    // Plain ASCII is by far the most common case
+    if (lead < 0x80)
+    {
+        pos++;
+        return lead;
+    }
+    // Work out how many continuation bytes should follow the lead byte, and
+    // the smallest code point that length is allowed to encode
+    size_t extra;
+    unsigned int cp;
+    unsigned int min;
+    if (lead >= 0xC2 && lead <= 0xDF)
+    {
+        extra = 1;
+        cp = lead & 0x1F;
+        min = 0x80;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF)
+    {
+        extra = 2;
+        cp = lead & 0x0F;
+        min = 0x800;
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4)
+    {
+        extra = 3;
+        cp = lead & 0x07;
+        min = 0x10000;
+    }
+    else
+    {
+        pos++;
+        return 0xFFFD;
+    }
+    if (pos + extra >= size)
+    {
+        pos++;
+        return 0xFFFD;
+    }
+    for (size_t i = 1; i <= extra; i++)
+    {
+        unsigned char next = (unsigned char)text[pos + i];
+        if ((next & 0xC0) != 0x80)
+        {
+            pos++;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (next & 0x3F);
+    }
+    // Reject overlong encodings, surrogates and values past unicode
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    {
+        pos++;
+        return 0xFFFD;
+    }
+    pos += extra + 1;
+    return cp;
+}
+
+/**
+ * How many columns a unicode code point takes up on the terminal
+ * (like wcwidth). Combining marks and control characters take none, wide
+ * East Asian characters and most emoji take two.
+ * @param code_point the unicode code point
+ * @return 0, 1 or 2
+ */
+int trio::char_width(unsigned int code_point)
+{
+    // Characters that are drawn on top of the one before them
+    static const unsigned int combining[][2] = {
+        {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x05BF, 0x05BF},
+        {0x05C1, 0x05C2}, {0x05C4, 0x05C5}, {0x05C7, 0x05C7}, {0x0610, 0x061A},
+        {0x064B, 0x065F}, {0x0670, 0x0670}, {0x06D6, 0x06DC}, {0x06DF, 0x06E4},
+        {0x06E7, 0x06E8}, {0x06EA, 0x06ED}, {0x0711, 0x0711}, {0x0730, 0x074A},
+        {0x07A6, 0x07B0}, {0x07EB, 0x07F3}, {0x0816, 0x0819}, {0x081B, 0x0823},
+        {0x0825, 0x0827}, {0x0829, 0x082D}, {0x0859, 0x085B}, {0x08D3, 0x08E1},
+        {0x08E3, 0x0902}, {0x093A, 0x093A}, {0x093C, 0x093C}, {0x0941, 0x0948},
+        {0x094D, 0x094D}, {0x0951, 0x0957}, {0x0962, 0x0963}, {0x0981, 0x0981},
+        {0x09BC, 0x09BC}, {0x09C1, 0x09C4}, {0x09CD, 0x09CD}, {0x09E2, 0x09E3},
+        {0x0A01, 0x0A02}, {0x0A3C, 0x0A3C}, {0x0A41, 0x0A42}, {0x0A47, 0x0A48},
+        {0x0A4B, 0x0A4D}, {0x0A70, 0x0A71}, {0x0A81, 0x0A82}, {0x0ABC, 0x0ABC},
+        {0x0AC1, 0x0AC5}, {0x0AC7, 0x0AC8}, {0x0ACD, 0x0ACD}, {0x0B01, 0x0B01},
+        {0x0B3C, 0x0B3C}, {0x0B3F, 0x0B3F}, {0x0B41, 0x0B44}, {0x0B4D, 0x0B4D},
+        {0x0B56, 0x0B56}, {0x0B82, 0x0B82}, {0x0BC0, 0x0BC0}, {0x0BCD, 0x0BCD},
+        {0x0C3E, 0x0C40}, {0x0C46, 0x0C48}, {0x0C4A, 0x0C4D}, {0x0C55, 0x0C56},
+        {0x0CBC, 0x0CBC}, {0x0CBF, 0x0CBF}, {0x0CC6, 0x0CC6}, {0x0CCC, 0x0CCD},
+        {0x0D41, 0x0D44}, {0x0D4D, 0x0D4D}, {0x0DCA, 0x0DCA}, {0x0DD2, 0x0DD4},
+        {0x0DD6, 0x0DD6}, {0x0E31, 0x0E31}, {0x0E34, 0x0E3A}, {0x0E47, 0x0E4E},
+        {0x0EB1, 0x0EB1}, {0x0EB4, 0x0EBC}, {0x0EC8, 0x0ECD}, {0x0F18, 0x0F19},
+        {0x0F35, 0x0F35}, {0x0F37, 0x0F37}, {0x0F39, 0x0F39}, {0x0F71, 0x0F7E},
+        {0x0F80, 0x0F84}, {0x0F86, 0x0F87}, {0x0F8D, 0x0FBC}, {0x0FC6, 0x0FC6},
+        {0x102D, 0x1030}, {0x1032, 0x1037}, {0x1039, 0x103A}, {0x1058, 0x1059},
+        {0x1160, 0x11FF}, {0x135D, 0x135F}, {0x1712, 0x1714}, {0x1732, 0x1734},
+        {0x1752, 0x1753}, {0x1772, 0x1773}, {0x17B4, 0x17B5}, {0x17B7, 0x17BD},
+        {0x17C6, 0x17C6}, {0x17C9, 0x17D3}, {0x17DD, 0x17DD}, {0x180B, 0x180E},
+        {0x18A9, 0x18A9}, {0x1920, 0x1922}, {0x1927, 0x1928}, {0x1932, 0x1932},
+        {0x1939, 0x193B}, {0x1A17, 0x1A18}, {0x1AB0, 0x1AFF}, {0x1B00, 0x1B03},
+        {0x1B34, 0x1B34}, {0x1B36, 0x1B3A}, {0x1B3C, 0x1B3C}, {0x1B42, 0x1B42},
+        {0x1B6B, 0x1B73}, {0x1DC0, 0x1DFF}, {0x200B, 0x200F}, {0x202A, 0x202E},
+        {0x2060, 0x206F}, {0x20D0, 0x20F0}, {0x2CEF, 0x2CF1}, {0x2D7F, 0x2D7F},
+        {0x2DE0, 0x2DFF}, {0x302A, 0x302D}, {0x3099, 0x309A}, {0xA66F, 0xA672},
+        {0xA674, 0xA67D}, {0xA69E, 0xA69F}, {0xA6F0, 0xA6F1}, {0xA802, 0xA802},
+        {0xA806, 0xA806}, {0xA80B, 0xA80B}, {0xA825, 0xA826}, {0xA8C4, 0xA8C5},
+        {0xA8E0, 0xA8F1}, {0xA926, 0xA92D}, {0xA947, 0xA951}, {0xA980, 0xA982},
+        {0xA9B3, 0xA9B3}, {0xA9B6, 0xA9B9}, {0xA9BC, 0xA9BC}, {0xAA29, 0xAA2E},
+        {0xAA31, 0xAA32}, {0xAA35, 0xAA36}, {0xAA43, 0xAA43}, {0xAA4C, 0xAA4C},
+        {0xAAB0, 0xAAB0}, {0xAAB2, 0xAAB4}, {0xAAB7, 0xAAB8}, {0xAABE, 0xAABF},
+        {0xAAC1, 0xAAC1}, {0xABE5, 0xABE5}, {0xABE8, 0xABE8}, {0xABED, 0xABED},
+        {0xD7B0, 0xD7FF}, {0xFB1E, 0xFB1E}, {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F},
+        {0xFEFF, 0xFEFF}, {0xFFF9, 0xFFFB}, {0x1D167, 0x1D169}, {0x1D173, 0x1D182},
+        {0x1D185, 0x1D18B}, {0x1D1AA, 0x1D1AD}, {0x1F3FB, 0x1F3FF}, {0xE0001, 0xE0001},
+        {0xE0020, 0xE007F}, {0xE0100, 0xE01EF}};
+    // Characters that take up two columns (East Asian Wide and Fullwidth)
+    static const unsigned int wide[][2] = {
+        {0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A}, {0x23E9, 0x23EC},
+        {0x23F0, 0x23F0}, {0x23F3, 0x23F3}, {0x25FD, 0x25FE}, {0x2614, 0x2615},
+        {0x2648, 0x2653}, {0x267F, 0x267F}, {0x2693, 0x2693}, {0x26A1, 0x26A1},
+        {0x26AA, 0x26AB}, {0x26BD, 0x26BE}, {0x26C4, 0x26C5}, {0x26CE, 0x26CE},
+        {0x26D4, 0x26D4}, {0x26EA, 0x26EA}, {0x26F2, 0x26F3}, {0x26F5, 0x26F5},
+        {0x26FA, 0x26FA}, {0x26FD, 0x26FD}, {0x2705, 0x2705}, {0x270A, 0x270B},
+        {0x2728, 0x2728}, {0x274C, 0x274C}, {0x274E, 0x274E}, {0x2753, 0x2755},
+        {0x2757, 0x2757}, {0x2795, 0x2797}, {0x27B0, 0x27B0}, {0x27BF, 0x27BF},
+        {0x2B1B, 0x2B1C}, {0x2B50, 0x2B50}, {0x2B55, 0x2B55}, {0x2E80, 0x3029},
+        {0x302E, 0x303E}, {0x3041, 0x3098}, {0x309B, 0xA4CF}, {0xA960, 0xA97F},
+        {0xAC00, 0xD7A3}, {0xF900, 0xFAFF}, {0xFE10, 0xFE19}, {0xFE30, 0xFE6F},
+        {0xFF00, 0xFF60}, {0xFFE0, 0xFFE6}, {0x16FE0, 0x16FE4}, {0x17000, 0x18CFF},
+        {0x18D00, 0x18D08}, {0x1AFF0, 0x1AFFE}, {0x1B000, 0x1B2FF}, {0x1F004, 0x1F004},
+        {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A}, {0x1F200, 0x1F202},
+        {0x1F210, 0x1F23B}, {0x1F240, 0x1F248}, {0x1F250, 0x1F251}, {0x1F260, 0x1F265},
+        {0x1F300, 0x1F320}, {0x1F32D, 0x1F335}, {0x1F337, 0x1F37C}, {0x1F37E, 0x1F393},
+        {0x1F3A0, 0x1F3CA}, {0x1F3CF, 0x1F3D3}, {0x1F3E0, 0x1F3F0}, {0x1F3F4, 0x1F3F4},
+        {0x1F3F8, 0x1F3FA}, {0x1F400, 0x1F43E}, {0x1F440, 0x1F440}, {0x1F442, 0x1F4FC},
+        {0x1F4FF, 0x1F53D}, {0x1F54B, 0x1F54E}, {0x1F550, 0x1F567}, {0x1F57A, 0x1F57A},
+        {0x1F595, 0x1F596}, {0x1F5A4, 0x1F5A4}, {0x1F5FB, 0x1F64F}, {0x1F680, 0x1F6C5},
+        {0x1F6CC, 0x1F6CC}, {0x1F6D0, 0x1F6D2}, {0x1F6D5, 0x1F6D7}, {0x1F6EB, 0x1F6EC},
+        {0x1F6F4, 0x1F6FC}, {0x1F7E0, 0x1F7EB}, {0x1F90C, 0x1F93A}, {0x1F93C, 0x1F945},
+        {0x1F947, 0x1F9FF}, {0x1FA70, 0x1FAFF}, {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD}};
+
+    // Everything before the combining marks is Latin, so skip the tables
+    if (code_point < 0x300)
+        return code_point < 0x20 || (code_point >= 0x7F && code_point < 0xA0) ? 0 : 1;
+    if (detail::in_ranges(code_point, combining, sizeof(combining) / sizeof(combining[0])))
+        return 0;
+    if (detail::in_ranges(code_point, wide, sizeof(wide) / sizeof(wide[0])))
+        return 2;
+    return 1;
+}
+
+/**
+ * How many columns some text takes up when printed. TrIO color codes take
+ * up no room, and "&&" is one column. If the text has several lines, the
+ * widest one is measured.
+ * @param text the text to measure
+ * @return the width of the text in columns
+ */
+size_t trio::text_width(const string &text)
+{
+    vector<detail::LineSpan> lines;
+    detail::split_lines(text, lines);
+    size_t width = 0;
+    for (size_t i = 0; i < lines.size(); i++)
+        width = std::max(width, detail::line_width(lines[i].text, lines[i].size));
+    return width;
+}
+
+/**
+ * Makes the program (or rather, current thread) stop executing and wait
+ * a specified length of time before continuing
+ * @param ms how much time, in miliseconds (1/1000 of a second), the
+ * program should sleep
+ */
+void trio::sleep_ms(int ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void trio::clear_screen()
+{
+#if defined(WINDOWS)
+    // The Windows version of this method comes almost character-for-character
+    // from the Microsoft docs. Credit Here:
+    // https://docs.microsoft.com/en-us/windows/console/clearing-the-screen
+    static HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    COORD coordScreen = {0, 0}; // home for the cursor
+    DWORD cCharsWritten;
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    DWORD dwConSize;
+    if (!GetConsoleScreenBufferInfo(hConsole, &csbi))
+    {
+        return;
+    }
+    dwConSize = csbi.dwSize.X * csbi.dwSize.Y;
+    if (!FillConsoleOutputCharacter(hConsole, (TCHAR)' ', dwConSize, coordScreen, &cCharsWritten))
+    {
+        return;
+    }
+    if (!GetConsoleScreenBufferInfo(hConsole, &csbi))
+    {
+        return;
+    }
+    if (!FillConsoleOutputAttribute(hConsole, csbi.wAttributes, dwConSize, coordScreen, &cCharsWritten))
+    {
+        return;
+    }
+    SetConsoleCursorPosition(hConsole, coordScreen);
+#else
+    // on *nix use ANSI escape
+    std::cout << "\033[2J" << std::flush;
+    // Return cursor to position 0,0 after clearing screen
+    std::cout << "\033[1;1f" << std::flush;
+#endif
+}
+
+/**
+ * Converts UTF-8 text to wide characters. Runs of ASCII are copied straight
+ * across (16 at a time where SSE2 is available). Invalid bytes become
+ * U+FFFD, the same way utf8_next() decodes them, so bad input never stops
+ * the output. Code points past U+FFFF become surrogate pairs when wchar_t
+ * is 16 bits (Windows).
+ * @param text the UTF-8 text
+ * @param size the number of bytes in the text
+ * @param wide where to put the wide characters, with room for at least size
+ * of them (no byte ever becomes more than one wide character)
+ * @return the number of wide characters written
+ */
+size_t trio::detail::widen(const char *text, size_t size, wchar_t *wide)
+{
+    wchar_t *next = wide;
+    size_t pos = 0;
+    while (pos < size)
+    {
+#if defined(TRIO_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        while (size - pos >= 16)
+        {
+            __m128i block = _mm_loadu_si128((const __m128i *)(text + pos));
+            if (_mm_movemask_epi8(block) != 0)
+                break;
+            // Every byte is ASCII, so widening is just adding zero bytes
+            __m128i low = _mm_unpacklo_epi8(block, zero);
+            __m128i high = _mm_unpackhi_epi8(block, zero);
+            if (sizeof(wchar_t) == 2)
+            {
+                _mm_storeu_si128((__m128i *)next, low);
+                _mm_storeu_si128((__m128i *)(next + 8), high);
+            }
+            else
+            {
+                _mm_storeu_si128((__m128i *)next, _mm_unpacklo_epi16(low, zero));
+                _mm_storeu_si128((__m128i *)(next + 4), _mm_unpackhi_epi16(low, zero));
+                _mm_storeu_si128((__m128i *)(next + 8), _mm_unpacklo_epi16(high, zero));
+                _mm_storeu_si128((__m128i *)(next + 12), _mm_unpackhi_epi16(high, zero));
+            }
+            next += 16;
+            pos += 16;
+        }
+#endif
+        while (pos < size && (unsigned char)text[pos] < 0x80)
+            *next++ = (wchar_t)text[pos++];
+        if (pos == size)
+            break;
+        unsigned int code_point = utf8_next(text, size, pos);
+        if (sizeof(wchar_t) == 2 && code_point > 0xFFFF)
+        {
+            // A 4 byte sequence becomes 2 wide characters, so there is room
+            code_point -= 0x10000;
+            *next++ = (wchar_t)(0xD800 + (code_point >> 10));
+            *next++ = (wchar_t)(0xDC00 + (code_point & 0x3FF));
+        }
+        else
+            *next++ = (wchar_t)code_point;
+    }
+    return next - wide;
+}
+
+/**
+ * Converts UTF-8 text to wide characters and sends it to a wide stream. The
+ * wide characters are put in a buffer that each thread keeps and reuses, so
+ * nothing is allocated once the buffer is big enough.
+ * @param wout the wide ostream to be output to
+ * @param text the UTF-8 text
+ * @param size the number of bytes in the text
+ */
+void trio::detail::write_wide(wostream &wout, const char *text, size_t size)
+{
+    static thread_local std::wstring wide;
+    if (wide.size() < size)
+        wide.resize(size);
+    wout.write(&wide[0], widen(text, size, &wide[0]));
+}
+
+/**
+ * It is easier to consistently pass in strings instead of keeping track of
+ * wide vs narrow strings. So, we will overload << to make wostreams able to
+ * work with strings (by converting them inside the operation to wstring)
+ * @param wout the wide ostream to be output to
+ * @param text the text to be converted to a wstring
+ * @return the same wostream being used (for chaining output statements)
+ */
+std::wostream &trio::operator<<(wostream &wout, const string &text)
+{
+    if (!text.empty())
+        detail::write_wide(wout, text.data(), text.size());
+    return wout;
+}
+
+namespace trio
+{
+    namespace detail
+    {
+        /** Index of the lowest set bit of a non-zero mask */
+        inline unsigned int lowest_bit(unsigned int mask)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return index;
+#else
+            return __builtin_ctz(mask);
+#endif
+        }
+
+        /** Plain byte-at-a-time search, works everywhere */
+        inline const char *find_markup_scalar(const char *first, const char *last)
+        {
+            while (first < last && *first != '&' && *first != '\n')
+                first++;
+            return first;
+        }
+
+#if defined(TRIO_SSE2)
+        /** Checks 16 bytes at a time */
+        inline const char *find_markup_sse2(const char *first, const char *last)
+        {
+            const __m128i amp = _mm_set1_epi8('&');
+            const __m128i nl = _mm_set1_epi8('\n');
+            while (last - first >= 16)
+            {
+                __m128i block = _mm_loadu_si128((const __m128i *)first);
+                __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, amp), _mm_cmpeq_epi8(block, nl));
+                unsigned int mask = (unsigned int)_mm_movemask_epi8(hits);
+                if (mask)
+                    return first + lowest_bit(mask);
+                first += 16;
+            }
+            return find_markup_scalar(first, last);
+        }
+#endif
+
+#if defined(TRIO_AVX2)
+        /** Checks 32 bytes at a time, only called if the CPU supports AVX2 */
+        __attribute__((target("avx2"))) inline const char *find_markup_avx2(const char *first, const char *last)
+        {
+            const __m256i amp = _mm256_set1_epi8('&');
+            const __m256i nl = _mm256_set1_epi8('\n');
+            while (last - first >= 32)
+            {
+                __m256i block = _mm256_loadu_si256((const __m256i *)first);
+                __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(block, amp), _mm256_cmpeq_epi8(block, nl));
+                unsigned int mask = (unsigned int)_mm256_movemask_epi8(hits);
+                if (mask)
+                    return first + lowest_bit(mask);
+                first += 32;
+            }
+            return find_markup_sse2(first, last);
+        }
+#endif
+
+        typedef const char *(*find_markup_fn)(const char *, const char *);
+
+        /** Picks the best find_markup implementation for this CPU */
+        inline find_markup_fn select_find_markup()
+        {
+#if defined(TRIO_AVX2)
+            if (__builtin_cpu_supports("avx2"))
+                return find_markup_avx2;
+#endif
+#if defined(TRIO_SSE2)
+            return find_markup_sse2;
+#else
+            return find_markup_scalar;
+#endif
+        }
+    } // namespace detail
+} // namespace trio
+
+/**
+ * Finds the first '&' or '\n' in [first, last). The implementation is
+ * picked the first time this is called, based on what the CPU supports.
+ * @param first the start of the text to search
+ * @param last one past the end of the text to search
+ * @return pointer to the first '&' or '\n' found, or last if there is none
+ */
+const char *trio::detail::find_markup(const char *first, const char *last)
+{
+    static const find_markup_fn impl = select_find_markup();
+    return impl(first, last);
+}
+
+/**
+ * Scans text for TrIO color codes in a single pass and reports what should
+ * be printed to a handler. The text is never copied; the handler receives
+ * spans pointing into it.
+ *
+ * The rules are the same ones TrIO has always used:
+ *  - "&FB" (F and B from 0-8) starts a new segment colored F/B
+ *  - "&&" prints a single '&'
+ *  - every '\n' acts like "&00\n", resetting the color for the next line
+ *    (so "&\n" is an escaped '&' followed by a plain "00\n")
+ *  - the color is reset to default after every segment
+ *  - a color code with no text after it is printed as-is
+ * @param text the text to scan
+ * @param size how many characters are in the text
+ * @param handler receives text(const char *, size_t) for each span to print
+ * and color(fg, bg) for each color change
+ */
+template <class Handler>
+void trio::detail::scan_markup(const char *text, size_t size, Handler &handler)
+{
+    if (size == 0)
+        return;
+    const char *const end = text + size;
+    // Start of plain text that has not been handed to the handler yet
+    const char *span = text;
+    // Where the next search for '&' or '\n' starts
+    const char *pos = text;
+    // A color code waits here until we know text follows it
+    bool pending = false;
+    const char *pending_code = 0;
+    // Hands text to the handler, applying a waiting color code first
+    struct Emitter
+    {
+        Handler &handler;
+        bool &pending;
+        const char *&pending_code;
+        void text(const char *first, size_t n)
+        {
+            if (n == 0)
+                return;
+            if (pending)
+            {
+                handler.color(pending_code[1] - '0', pending_code[2] - '0');
+                pending = false;
+            }
+            handler.text(first, n);
+        }
+        void end_segment()
+        {
+            // A code with nothing after it is printed literally
+            if (pending)
+            {
+                handler.text(pending_code, 3);
+                pending = false;
+            }
+            handler.color(0, 0);
+        }
+        void start_segment(const char *code)
+        {
+            end_segment();
+            pending = true;
+            pending_code = code;
+        }
+    } emit = {handler, pending, pending_code};
+    static const char newline_code[] = "&00";
+
+    while (pos < end)
+    {
+        const char *hit = find_markup(pos, end);
+        if (hit == end)
+            break;
+        if (*hit == '\n')
+        {
+            emit.text(span, hit - span);
+            emit.start_segment(newline_code);
+            span = hit;
+            pos = hit + 1;
+            continue;
+        }
+        // *hit is '&', what comes after it decides what it means
+        if (hit + 1 == end)
+            break;
+        const char next = hit[1];
+        if (next == '&' || next == '\0')
+        {
+            // Escaped '&' (a stray '\0' after '&' is dropped too)
+            emit.text(span, hit + 1 - span);
+            span = pos = hit + 2;
+        }
+        else if (next == '\n')
+        {
+            // The '&' escapes the newline's reset code, leaving "00\n"
+            emit.text(span, hit + 1 - span);
+            emit.text(newline_code + 1, 2);
+            span = hit + 1;
+            pos = hit + 2;
+        }
+        else if (next >= '0' && next <= '8' && hit + 2 < end && hit[2] >= '0' && hit[2] <= '8')
+        {
+            emit.text(span, hit - span);
+            emit.start_segment(hit);
+            span = pos = hit + 3;
+        }
+        else
+        {
+            // A lone '&' is just text
+            pos = hit + 1;
+        }
+    }
+    emit.text(span, end - span);
+    emit.end_segment();
+}
+
+/*  888888ba           oo            dP      8888ba.88ba             dP   dP                      dP          
+ *  88    `8b                        88      88  `8b  `8b            88   88                      88          
+ * a88aaaa8P' .d8888b. dP 88d888b. d8888P    88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ *  88        88'  `88 88 88'  `88   88      88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ *  88        88.  .88 88 88    88   88      88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ *  dP        `88888P' dP dP    dP   dP      dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Creates a point
+ * @param row the row where the point is positioned
+ * @param col the column where the point is positioned
+ */
+trio::Point::Point(const unsigned short &row, const unsigned short &col)
+{
+    this->row = row;
+    this->col = col;
+}
+
+/**
+ * Creates a Rect
+ * @param row the row of the top left corner
+ * @param col the column of the top left corner
+ * @param rows how many rows the Rect covers
+ * @param cols how many columns the Rect covers
+ */
+trio::Rect::Rect(const unsigned short &row, const unsigned short &col, const unsigned short &rows, const unsigned short &cols)
+{
+    this->row = row;
+    this->col = col;
+    this->rows = rows;
+    this->cols = cols;
+}
+
+bool trio::Rect::empty() const
+{
+    return rows == 0 || cols == 0;
+}
+
+/**
+ * Finds the part of this Rect that is also inside another Rect
+ * @param other the other Rect
+ * @return the overlap, which is empty if they don't overlap
+ */
+trio::Rect trio::Rect::intersect(const Rect &other) const
+{
+    unsigned int top = std::max(row, other.row);
+    unsigned int left = std::max(col, other.col);
+    unsigned int bottom = std::min((unsigned int)row + rows, (unsigned int)other.row + other.rows);
+    unsigned int right = std::min((unsigned int)col + cols, (unsigned int)other.col + other.cols);
+    if (bottom <= top || right <= left)
+        return Rect(top, left, 0, 0);
+    return Rect(top, left, bottom - top, right - left);
+}
+
+/**
+ * Finds the smallest Rect that covers this Rect and another one. An empty
+ * Rect doesn't cover anything, so it doesn't stretch the result.
+ * @param other the other Rect
+ * @return the Rect covering both
+ */
+trio::Rect trio::Rect::unite(const Rect &other) const
+{
+    if (other.empty())
+        return *this;
+    if (empty())
+        return other;
+    unsigned int top = std::min(row, other.row);
+    unsigned int left = std::min(col, other.col);
+    unsigned int bottom = std::max((unsigned int)row + rows, (unsigned int)other.row + other.rows);
+    unsigned int right = std::max((unsigned int)col + cols, (unsigned int)other.col + other.cols);
+    return Rect(top, left, std::min(bottom - top, 0xFFFFu), std::min(right - left, 0xFFFFu));
+}
+
+bool trio::Rect::operator==(const Rect &other) const
+{
+    return row == other.row && col == other.col && rows == other.rows && cols == other.cols;
+}
+
+bool trio::Rect::operator!=(const Rect &other) const
+{
+    return !(*this == other);
+}
+
+/*  a88888b.          dP                      8888ba.88ba             dP   dP                      dP          
+ * d8'   `88          88                      88  `8b  `8b            88   88                      88          
+ * 88        .d8888b. 88 .d8888b. 88d888b.    88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ * 88        88'  `88 88 88'  `88 88'  `88    88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * Y8.   .88 88.  .88 88 88.  .88 88          88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ *  Y88888P' `88888P' dP `88888P' dP          dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * oooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Creates a Color object
+ * @param fg color code for the foreground
+ * @param bg color code for the background
+ */
+trio::Color::Color(const unsigned int &fg, const unsigned int &bg)
+{
+    this->fg = fg;
+    this->bg = bg;
+}
+
+bool trio::Color::operator==(const Color &other) const
+{
+    return fg == other.fg && bg == other.bg;
+}
+
+bool trio::Color::operator!=(const Color &other) const
+{
+    return !(*this == other);
+}
+
+/**
+ * Gets the color code for an entry of the terminal's 256 color palette. The
+ * first 16 entries are the terminal's own colors, 16 to 231 are a 6x6x6 cube
+ * of colors, and 232 to 255 are grays from dark to light.
+ * @param index the palette entry
+ * @return the color code, for a Color or Cell
+ */
+unsigned int trio::palette(unsigned char index)
+{
+    return detail::palette_code | index;
+}
+
+/**
+ * Gets the color code for a 24-bit color. Terminals that can't show it get
+ * the closest palette entry (or TrIO color) instead.
+ * @param red how much red, from 0 to 255
+ * @param green how much green, from 0 to 255
+ * @param blue how much blue, from 0 to 255
+ * @return the color code, for a Color or Cell
+ */
+unsigned int trio::rgb(unsigned char red, unsigned char green, unsigned char blue)
+{
+    return detail::rgb_code | (unsigned int)red << 16 | (unsigned int)green << 8 | blue;
+}
+
+/**
+ * Finds the closest color code a terminal can show. Palette entries and
+ * 24-bit colors become the closest TrIO color on 8 color terminals, and
+ * 24-bit colors become the closest palette entry on 256 color terminals.
+ * Codes that aren't valid become the default color.
+ * @param code a TrIO color code, or one from palette() or rgb()
+ * @param depth how many colors the terminal can show
+ * @return a color code the terminal can show
+ */
+unsigned int trio::detail::fit_color(unsigned int code, ColorDepth depth)
+{
+    if (code <= WHITE)
+        return code;
+    unsigned int red, green, blue;
+    if (code >= rgb_code && code <= (rgb_code | 0xFFFFFF))
+    {
+        if (depth == COLORS_TRUE)
+            return code;
+        if (depth == COLORS_256)
+            return palette_code | nearest_palette(code);
+        red = (code >> 16) & 0xFF;
+        green = (code >> 8) & 0xFF;
+        blue = code & 0xFF;
+    }
+    else if (code >= palette_code && code <= (palette_code | 0xFF))
+    {
+        const unsigned int index = code & 0xFF;
+        if (depth != COLORS_8)
+            return code;
+        // The terminal's own colors are the TrIO colors (and bright versions)
+        static const unsigned short ansi_to_trio[] = {BLACK, RED, GREEN, YELLOW, BLUE, MAGENTA, CYAN, WHITE};
+        if (index < 16)
+            return ansi_to_trio[index % 8];
+        if (index >= 232)
+            red = green = blue = 8 + 10 * (index - 232);
+        else
+        {
+            static const unsigned char levels[] = {0, 95, 135, 175, 215, 255};
+            red = levels[(index - 16) / 36];
+            green = levels[(index - 16) / 6 % 6];
+            blue = levels[(index - 16) % 6];
+        }
+    }
+    else
+        return DEFAULT;
+    // Each TrIO color is either off or fully on in each channel
+    static const unsigned short by_channels[] = {BLACK, BLUE, GREEN, CYAN, RED, MAGENTA, YELLOW, WHITE};
+    return by_channels[(red >= 128) << 2 | (green >= 128) << 1 | (blue >= 128)];
+}
+
+/**
+ * Finds the closest entry of the 256 color palette (leaving out the first
+ * 16, which differ between terminals) to a 24-bit color. The answers for
+ * every color, at 5 bits per channel, are worked out the first time this
+ * is called, so afterwards it is a single table lookup.
+ * @param rgb a color code from rgb()
+ * @return the palette entry
+ */
+unsigned char trio::detail::nearest_palette(unsigned int rgb)
+{
+    struct Table
+    {
+        unsigned char nearest[32 * 32 * 32];
+        Table()
+        {
+            static const int levels[] = {0, 95, 135, 175, 215, 255};
+            // The closest level of the color cube for each channel value
+            unsigned char cube[256];
+            for (int value = 0, level = 0; value < 256; value++)
+            {
+                while (level < 5 && value - levels[level] > levels[level + 1] - value)
+                    level++;
+                cube[value] = (unsigned char)level;
+            }
+            for (int i = 0; i < 32 * 32 * 32; i++)
+            {
+                // The middle of the range of colors this entry stands for
+                const int rgb[3] = {(i >> 10) << 3 | 4, (i >> 5 & 31) << 3 | 4, (i & 31) << 3 | 4};
+                int distance = 0;
+                for (int c = 0; c < 3; c++)
+                    distance += (rgb[c] - levels[cube[rgb[c]]]) * (rgb[c] - levels[cube[rgb[c]]]);
+                int best = 16 + 36 * cube[rgb[0]] + 6 * cube[rgb[1]] + cube[rgb[2]];
+                // A gray might be closer than the cube's closest color
+                const int average = (rgb[0] + rgb[1] + rgb[2]) / 3;
+                const int step = std::min(23, std::max(0, (average - 8 + 5) / 10));
+                const int gray = 8 + 10 * step;
+                int gray_distance = 0;
+                for (int c = 0; c < 3; c++)
+                    gray_distance += (rgb[c] - gray) * (rgb[c] - gray);
+                if (gray_distance < distance)
+                    best = 232 + step;
+                nearest[i] = (unsigned char)best;
+            }
+        }
+    };
+    static const Table table;
+    return table.nearest[(rgb >> 9 & 0x7C00) | (rgb >> 6 & 0x3E0) | (rgb >> 3 & 0x1F)];
+}
+
+/* 8888ba.88ba                    dP                             8888ba.88ba             dP   dP                      dP          
+ * 88  `8b  `8b                   88                             88  `8b  `8b            88   88                      88          
+ * 88   88   88 .d8888b. 88d888b. 88  .dP  dP    dP 88d888b.     88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ * 88   88   88 88'  `88 88'  `88 88888"   88    88 88'  `88     88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * 88   88   88 88.  .88 88       88  `8b. 88.  .88 88.  .88     88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ * dP   dP   dP `88888P8 dP       dP   `YP `88888P' 88Y888P'     dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * oooooooooooooooooooooooooooooooooooooooooooooooo~88~ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ *                                                  dP                                                                            
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Parses a string containing color codes
+ * @param source the string to parse, using the same rules as printing it
+ */
+trio::Markup::Markup(const string &source)
+{
+    Builder builder = {*this};
+    detail::scan_markup(source.data(), source.size(), builder);
+}
+
+/**
+ * Parses a string containing color codes
+ * @param source the string to parse, using the same rules as printing it
+ */
+trio::Markup::Markup(const char *source)
+{
+    Builder builder = {*this};
+    detail::scan_markup(source, std::char_traits<char>::length(source), builder);
+}
+
+/**
+ * The text to print, with all of the color codes removed
+ * @return every span of printable text, back to back
+ */
+const std::string &trio::Markup::text() const
+{
+    return printable;
+}
+
+/**
+ * The color changes and spans of text, in order. Each entry's offset and
+ * length point into text().
+ * @return the parsed entries
+ */
+const std::vector<trio::MarkupEntry> &trio::Markup::entries() const
+{
+    return parsed;
+}
+
+/**
+ * Stores a span of text found while parsing, adding it to the last entry
+ * @param text the characters to store
+ * @param size how many characters to store
+ */
+void trio::Markup::Builder::text(const char *text, size_t size)
+{
+    if (markup.parsed.empty())
+    {
+        MarkupEntry entry = {false, 0, 0, 0, 0};
+        markup.parsed.push_back(entry);
+    }
+    markup.printable.append(text, size);
+    markup.parsed.back().length += size;
+}
+
+/**
+ * Stores a color change found while parsing as a new entry
+ * @param fg color code for the foreground
+ * @param bg color code for the background
+ */
+void trio::Markup::Builder::color(unsigned short fg, unsigned short bg)
+{
+    MarkupEntry entry = {true, fg, bg, markup.printable.size(), 0};
+    markup.parsed.push_back(entry);
+}
+
+/* 888888ba                       8888ba.88ba                 dP              8888ba.88ba             dP   dP                      dP          
+ * 88    `8b                      88  `8b  `8b                88              88  `8b  `8b            88   88                      88          
+ * a88aaaa8P' .d8888b. dP  dP  dP 88   88   88 .d8888b. .d888b88 .d8888b.     88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ * 88   `8b.  88'  `88 88  88  88 88   88   88 88'  `88 88'  `88 88ooood8     88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * 88     88  88.  .88 88.88b.88' 88   88   88 88.  .88 88.  .88 88.  ...     88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ * dP     dP  `88888P8 8888P Y8P  dP   dP   dP `88888P' `88888P8 `88888P'     dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * oooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+namespace trio
+{
+    namespace detail
+    {
+        /** What RawMode needs to remember, shared by every session */
+        struct RawModeState
+        {
+            int depth;
+            bool saved_ok;
+#if defined(WINDOWS)
+            HANDLE input;
+            DWORD saved_mode;
+#else
+            struct termios saved;
+            struct sigaction old_actions[4];
+#endif
+        };
+
+        inline RawModeState &raw_mode_state()
+        {
+            static RawModeState state = RawModeState();
+            return state;
+        }
+
+#if !defined(WINDOWS)
+        /** The signals that would kill the program while in raw mode */
+        inline const int *raw_mode_signals()
+        {
+            static const int signals[4] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT};
+            return signals;
+        }
+
+        /**
+         * Hands a signal to whatever handled it before TrIO. If that would
+         * kill the program, the terminal is put back to normal first (when
+         * it is in raw mode) and the signal raised again. A handler of the
+         * program's own is called and the program keeps going, so raw mode
+         * (and this handler) stay in place.
+         */
+        inline void raw_mode_signal(int sig, siginfo_t *info, void *context)
+        {
+            RawModeState &state = raw_mode_state();
+            for (int i = 0; i < 4; i++)
+            {
+                if (raw_mode_signals()[i] != sig)
+                    continue;
+                const struct sigaction &old = state.old_actions[i];
+                if (old.sa_flags & SA_SIGINFO)
+                    old.sa_sigaction(sig, info, context);
+                else if (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN)
+                    old.sa_handler(sig);
+                else if (old.sa_handler == SIG_DFL)
+                {
+                    if (state.depth > 0 && state.saved_ok)
+                    {
+                        // Nothing can be done here if the write fails
+                        if (isatty(1))
+                        {
+                            ssize_t written = write(1, "\033[?2004l", 8);
+                            (void)written;
+                        }
+                        tcsetattr(0, TCSANOW, &state.saved);
+                    }
+                    sigaction(sig, &old, 0);
+                    raise(sig);
+                }
+                return;
+            }
+        }
+
+        /**
+         * Starts watching the signals that would kill the program, the
+         * first time it is called, so the terminal isn't left in raw mode.
+         * The handler stays in place from then on (it only forwards the
+         * signal while the terminal isn't in raw mode), so raw mode
+         * sessions don't cost any sigaction() calls. Ignored signals are
+         * left ignored.
+         */
+        inline void watch_raw_mode_signals()
+        {
+            struct Watcher
+            {
+                Watcher()
+                {
+                    RawModeState &state = raw_mode_state();
+                    struct sigaction action;
+                    memset(&action, 0, sizeof(action));
+                    action.sa_sigaction = raw_mode_signal;
+                    action.sa_flags = SA_SIGINFO;
+                    sigemptyset(&action.sa_mask);
+                    for (int i = 0; i < 4; i++)
+                    {
+                        struct sigaction &old = state.old_actions[i];
+                        sigaction(raw_mode_signals()[i], 0, &old);
+                        if ((old.sa_flags & SA_SIGINFO) || old.sa_handler != SIG_IGN)
+                            sigaction(raw_mode_signals()[i], &action, 0);
+                    }
+                }
+            };
+            static Watcher watcher;
+            (void)watcher;
+        }
+
+        /** How many times the terminal has been resized, counted by SIGWINCH */
+        inline std::atomic<unsigned int> &resize_count()
+        {
+            static std::atomic<unsigned int> count(0);
+            return count;
+        }
+
+        /** What SIGWINCH did before TrIO started watching it */
+        inline struct sigaction &old_resize_action()
+        {
+            static struct sigaction action;
+            return action;
+        }
+
+        /**
+         * Counts a resize, then lets whatever handled SIGWINCH before
+         * handle it too. Only an atomic increment happens here, since
+         * little else is safe in a signal handler.
+         */
+        inline void resize_signal(int sig, siginfo_t *info, void *context)
+        {
+            resize_count().fetch_add(1, std::memory_order_relaxed);
+            const struct sigaction &old = old_resize_action();
+            if (old.sa_flags & SA_SIGINFO)
+                old.sa_sigaction(sig, info, context);
+            else if (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN)
+                old.sa_handler(sig);
+        }
+
+        /** Starts counting resizes, the first time it is called */
+        inline void watch_resize()
+        {
+            struct Watcher
+            {
+                Watcher()
+                {
+                    // Make sure the count exists before the handler uses it
+                    resize_count();
+                    struct sigaction action;
+                    memset(&action, 0, sizeof(action));
+                    action.sa_sigaction = resize_signal;
+                    sigemptyset(&action.sa_mask);
+                    action.sa_flags = SA_RESTART | SA_SIGINFO;
+                    sigaction(SIGWINCH, &action, &old_resize_action());
+                }
+            };
+            static Watcher watcher;
+            (void)watcher;
+        }
+#endif
+    } // namespace detail
+} // namespace trio
+
+/**
+ * Puts the terminal in unbuffered, echoless mode until this object goes
+ * away. Sessions can be nested; only the outermost one changes the
+ * terminal.
+ */
+trio::RawMode::RawMode()
+{
+    detail::RawModeState &state = detail::raw_mode_state();
+    if (state.depth++ > 0)
+        return;
+#if defined(WINDOWS)
+    state.input = GetStdHandle(STD_INPUT_HANDLE);
+    state.saved_ok = GetConsoleMode(state.input, &state.saved_mode) != 0;
+    if (state.saved_ok)
+        SetConsoleMode(state.input, 0);
+#else
+    // If stdin isn't a terminal there is no mode to change
+    state.saved_ok = isatty(0) && tcgetattr(0, &state.saved) == 0;
+    if (!state.saved_ok)
+        return;
+    struct termios raw = state.saved;
+    raw.c_lflag &= ~ICANON;
+    raw.c_lflag &= ~ECHO;
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    // Make sure the terminal isn't left in raw mode if we are killed
+    detail::watch_raw_mode_signals();
+    if (tcsetattr(0, TCSANOW, &raw) < 0)
+        perror("tcsetattr ICANON");
+    // Ask the terminal to mark pastes so they can be read as one Key
+    if (isatty(1) && write(1, "\033[?2004h", 8) < 0)
+        perror("write()");
+#endif
+}
+
+/**
+ * Puts the terminal back the way it was before the outermost session
+ */
+trio::RawMode::~RawMode()
+{
+    detail::RawModeState &state = detail::raw_mode_state();
+    if (--state.depth > 0 || !state.saved_ok)
+        return;
+#if defined(WINDOWS)
+    SetConsoleMode(state.input, state.saved_mode);
+#else
+    if (isatty(1) && write(1, "\033[?2004l", 8) < 0)
+        perror("write()");
+    if (tcsetattr(0, TCSADRAIN, &state.saved) < 0)
+        perror("tcsetattr ~ICANON");
+#endif
+}
+
+/**
+ * Whether a RawMode session is active
+ * @return true if the terminal is being kept in raw mode
+ */
+bool trio::RawMode::active()
+{
+    return detail::raw_mode_state().depth > 0;
+}
+
+/* dP     dP                       8888ba.88ba             dP   dP                      dP          
+ * 88   .d8'                       88  `8b  `8b            88   88                      88          
+ * 88aaa8P'  .d8888b. dP    dP     88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ * 88   `8b. 88ooood8 88    88     88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * 88     88 88.  ... 88.  .88     88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ * dP     dP `88888P' `8888P88     dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * ooooooooooooooooooooooo~.88~ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ *                     d8888P                                                                       
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Creates a Key
+ * @param code the unicode code point of the character typed, or a KeyCode
+ * @param mods the KeyModifiers that were held down
+ */
+trio::Key::Key(const unsigned int &code, const unsigned int &mods)
+{
+    this->code = code;
+    this->mods = mods;
+}
+
+/**
+ * A readable name for the key. Characters are named by themselves, other
+ * keys by words, with any modifiers in front (like "Ctrl+Shift+Left").
+ * @return the name of the key
+ */
+std::string trio::Key::name() const
+{
+    static const char *const names[] = {
+        "Up", "Down", "Right", "Left", "Home", "End", "Insert", "Delete",
+        "PageUp", "PageDown", "F1", "F2", "F3", "F4", "F5", "F6", "F7",
+        "F8", "F9", "F10", "F11", "F12", "Paste"};
+    string result;
+    if (mods & KEY_CTRL)
+        result += "Ctrl+";
+    if (mods & KEY_ALT)
+        result += "Alt+";
+    if (mods & KEY_SHIFT)
+        result += "Shift+";
+    if (code >= KEY_UP && code <= KEY_PASTE)
+        result += names[code - KEY_UP];
+    else if (code == '\r' || code == '\n')
+        result += "Enter";
+    else if (code == '\t')
+        result += "Tab";
+    else if (code == 27)
+        result += "Escape";
+    else if (code == 127 || code == 8)
+        result += "Backspace";
+    else if (code == ' ')
+        result += "Space";
+    else if (code < 32)
+    {
+        // Ctrl+A through Ctrl+Z (and a few others) type control characters
+        result += "Ctrl+";
+        result += char('@' + code);
+    }
+    else
+        utf8_append(result, code);
+    return result;
+}
+
+/**
+ * Creates an empty queue
+ */
+template <class T, size_t Capacity>
+trio::detail::SpscQueue<T, Capacity>::SpscQueue() : head(0), tail(0)
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+}
+
+/**
+ * Adds an item to the queue. Only the producer thread may call this.
+ * @param item the item to add
+ * @return false if the queue is full and the item was not added
+ */
+template <class T, size_t Capacity>
+bool trio::detail::SpscQueue<T, Capacity>::push(const T &item)
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == Capacity)
+        return false;
+    slots[t & (Capacity - 1)] = item;
+    // Publishes the item to the consumer
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * Takes the oldest item out of the queue. Only the consumer thread may
+ * call this.
+ * @param item the variable to move the item into
+ * @return false if the queue was empty
+ */
+template <class T, size_t Capacity>
+bool trio::detail::SpscQueue<T, Capacity>::pop(T &item)
+{
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+        return false;
+    item = std::move(slots[h & (Capacity - 1)]);
+    // Gives the slot back to the producer
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * Whether the queue is empty
+ * @return true if there is nothing to pop
+ */
+template <class T, size_t Capacity>
+bool trio::detail::SpscQueue<T, Capacity>::empty() const
+{
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+}
+
+/**
+ * Creates an empty queue. The queue always holds one node whose item has
+ * already been taken (or never existed), so head and tail are never null.
+ */
+template <class T>
+trio::detail::MpscQueue<T>::MpscQueue()
+{
+    Node *empty = new Node();
+    empty->next.store(nullptr, std::memory_order_relaxed);
+    head.store(empty, std::memory_order_relaxed);
+    tail = empty;
+}
+
+/**
+ * Frees every node, including items that were never popped
+ */
+template <class T>
+trio::detail::MpscQueue<T>::~MpscQueue()
+{
+    while (tail)
+    {
+        Node *next = tail->next.load(std::memory_order_relaxed);
+        delete tail;
+        tail = next;
+    }
+}
+
+/**
+ * Adds an item to the queue. Any thread may call this, and it never waits
+ * for other threads.
+ * @param item the item to move into the queue
+ */
+template <class T>
+void trio::detail::MpscQueue<T>::push(T &&item)
+{
+    Node *node = new Node();
+    node->next.store(nullptr, std::memory_order_relaxed);
+    node->item = std::move(item);
+    // Claims the end of the queue, then links the old end to the new node.
+    // Until the link is stored the consumer just sees the queue end early.
+    Node *previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+/**
+ * Takes the oldest item out of the queue. Only the consumer thread may
+ * call this.
+ * @param item the variable to move the item into
+ * @return false if there was nothing ready to pop
+ */
+template <class T>
+bool trio::detail::MpscQueue<T>::pop(T &item)
+{
+    Node *next = tail->next.load(std::memory_order_acquire);
+    if (!next)
+        return false;
+    item = std::move(next->item);
+    // next becomes the empty node at the front of the queue
+    delete tail;
+    tail = next;
+    return true;
+}
+
+/**
+ * Creates a decoder with no input
+ */
+trio::detail::KeyDecoder::KeyDecoder()
+{
+    start = 0;
+    pasting = false;
+    paste_scanned = 0;
+}
+
+/**
+ * Adds bytes read from the terminal to be decoded
+ * @param bytes the bytes that were read
+ * @param size how many bytes were read
+ */
+void trio::detail::KeyDecoder::feed(const unsigned char *bytes, size_t size)
+{
+    // Forget what was already decoded before it piles up
+    if (start > 0)
+    {
+        pending.erase(0, start);
+        paste_scanned -= std::min(paste_scanned, start);
+        start = 0;
+    }
+    pending.append((const char *)bytes, size);
+}
+
+/**
+ * Decodes the next key
+ * @param key the variable to decode the key into
+ * @param timed_out whether to stop waiting for the rest of a sequence
+ * @return whether a key was decoded
+ */
+bool trio::detail::KeyDecoder::next(Key &key, bool timed_out)
+{
+    while (true)
+    {
+        if (pasting)
+        {
+            // A paste is everything up to ESC [ 201 ~, however long it is.
+            // Only the new bytes are searched each time more arrive.
+            static const char end_mark[] = "\033[201~";
+            size_t end = pending.find(end_mark, paste_scanned, 6);
+            if (end == string::npos && !timed_out)
+            {
+                paste_scanned = std::max(start, pending.size() < 5 ? 0 : pending.size() - 5);
+                return false;
+            }
+            key = Key(KEY_PASTE);
+            if (end == string::npos)
+                end = pending.size();
+            key.text.assign(pending, start, end - start);
+            start = std::min(end + 6, pending.size());
+            pasting = false;
+            return true;
+        }
+        if (start >= pending.size())
+            return false;
+        size_t pos = start;
+        Result result = decode(pos, key, timed_out);
+        if (result == INCOMPLETE)
+            return false;
+        start = pos;
+        if (result == COMPLETE)
+            return true;
+        if (result == PASTE_START)
+        {
+            pasting = true;
+            paste_scanned = start;
+        }
+    }
+}
+
+/**
+ * Whether bytes are being held back to see what follows them. A paste is
+ * not partial, since there is no telling how long it could take.
+ * @return true if there are undecoded bytes outside of a paste
+ */
+bool trio::detail::KeyDecoder::partial() const
+{
+    return !pasting && start < pending.size();
+}
+
+/**
+ * The bytes that haven't been decoded yet
+ * @return the undecoded bytes
+ */
+std::string trio::detail::KeyDecoder::rest() const
+{
+    return pending.substr(start);
+}
+
+/**
+ * Decodes the key starting at pos
+ * @param pos where the key starts, moved past it
+ * @param key the variable to decode the key into
+ * @param timed_out whether to stop waiting for the rest of a sequence
+ * @return whether a key was decoded, skipped, or needs more bytes
+ */
+trio::detail::KeyDecoder::Result trio::detail::KeyDecoder::decode(size_t &pos, Key &key, bool timed_out) const
+{
+    const unsigned char *bytes = (const unsigned char *)pending.data();
+    size_t size = pending.size();
+    unsigned char lead = bytes[pos];
+    if (lead != 27)
+    {
+        // Wait for the rest of a character that was split between reads
+        size_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC2 ? 2 : 1;
+        if (pos + length > size && !timed_out)
+        {
+            size_t i = pos + 1;
+            while (i < size && (bytes[i] & 0xC0) == 0x80)
+                i++;
+            if (i == size)
+                return INCOMPLETE;
+        }
+        key = Key(utf8_next(pending.data(), size, pos));
+        return COMPLETE;
+    }
+    if (pos + 1 == size)
+    {
+        // Nothing came after the ESC in time, so it was the Escape key
+        if (!timed_out)
+            return INCOMPLETE;
+        pos++;
+        key = Key(27);
+        return COMPLETE;
+    }
+    if (bytes[pos + 1] == '[')
+        return decode_csi(pos, key, timed_out);
+    if (bytes[pos + 1] == 'O')
+        return decode_ss3(pos, key, timed_out);
+    // ESC in front of any other key means Alt was held down
+    size_t inner = pos + 1;
+    Result result = decode(inner, key, timed_out);
+    if (result == INCOMPLETE)
+        return INCOMPLETE;
+    key.mods |= KEY_ALT;
+    pos = inner;
+    return result;
+}
+
+/**
+ * Decodes a sequence starting with ESC [, which is how most special keys
+ * are sent. Modifiers are the second parameter, like ESC [ 1 ; 5 A for
+ * Ctrl+Up.
+ * @param pos where the sequence starts, moved past it
+ * @param key the variable to decode the key into
+ * @param timed_out whether to stop waiting for the rest of the sequence
+ * @return whether a key was decoded, skipped, or needs more bytes
+ */
+trio::detail::KeyDecoder::Result trio::detail::KeyDecoder::decode_csi(size_t &pos, Key &key, bool timed_out) const
+{
+    // Keys sent with ESC [ ... ~, by their first parameter
+    static const unsigned int tilde_keys[25] = {
+        0, KEY_HOME, KEY_INSERT, KEY_DELETE, KEY_END, KEY_PAGE_UP,
+        KEY_PAGE_DOWN, KEY_HOME, KEY_END, 0, 0, KEY_F1, KEY_F2, KEY_F3,
+        KEY_F4, KEY_F5, 0, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, 0,
+        KEY_F11, KEY_F12};
+    const unsigned char *bytes = (const unsigned char *)pending.data();
+    size_t size = pending.size();
+    size_t i = pos + 2;
+    // The Linux console sends F1 through F5 as ESC [ [ A through E
+    bool linux_f = i < size && bytes[i] == '[';
+    if (linux_f)
+        i++;
+    unsigned int params[2] = {0, 0};
+    size_t count = 0;
+    while (i < size && bytes[i] >= 0x20 && bytes[i] <= 0x3F)
+    {
+        if (bytes[i] >= '0' && bytes[i] <= '9' && count < 2 && params[count] < 10000)
+            params[count] = params[count] * 10 + (bytes[i] - '0');
+        else if (bytes[i] == ';')
+            count++;
+        i++;
+    }
+    if (i >= size)
+    {
+        if (!timed_out)
+            return INCOMPLETE;
+        // The sequence never finished, so it must have been Alt+[
+        pos += 2;
+        key = Key('[', KEY_ALT);
+        return COMPLETE;
+    }
+    unsigned char letter = bytes[i];
+    if (letter < 0x40 || letter > 0x7E)
+    {
+        // Not a sequence after all, leave the byte for the next key
+        pos = i;
+        return SKIPPED;
+    }
+    pos = i + 1;
+    unsigned int mods = params[1] > 1 ? (params[1] - 1) & (KEY_SHIFT | KEY_ALT | KEY_CTRL) : 0;
+    unsigned int code = 0;
+    if (linux_f)
+    {
+        if (letter >= 'A' && letter <= 'E')
+            code = KEY_F1 + (letter - 'A');
+    }
+    else if (letter == '~')
+    {
+        if (params[0] == 200)
+            return PASTE_START;
+        if (params[0] < 25)
+            code = tilde_keys[params[0]];
+    }
+    else if (letter == 'Z')
+    {
+        key = Key('\t', KEY_SHIFT);
+        return COMPLETE;
+    }
+    else
+    {
+        const char *letters = "ABCDHFPQRS";
+        const char *found = strchr(letters, letter);
+        static const unsigned int letter_keys[] = {
+            KEY_UP, KEY_DOWN, KEY_RIGHT, KEY_LEFT, KEY_HOME, KEY_END,
+            KEY_F1, KEY_F2, KEY_F3, KEY_F4};
+        if (found)
+            code = letter_keys[found - letters];
+    }
+    if (code == 0)
+        return SKIPPED;
+    key = Key(code, mods);
+    return COMPLETE;
+}
+
+/**
+ * Decodes a sequence starting with ESC O, which some terminals use for the
+ * arrows, Home/End and F1 through F4
+ * @param pos where the sequence starts, moved past it
+ * @param key the variable to decode the key into
+ * @param timed_out whether to stop waiting for the rest of the sequence
+ * @return whether a key was decoded, skipped, or needs more bytes
+ */
+trio::detail::KeyDecoder::Result trio::detail::KeyDecoder::decode_ss3(size_t &pos, Key &key, bool timed_out) const
+{
+    static const unsigned int letter_keys[] = {
+        KEY_UP, KEY_DOWN, KEY_RIGHT, KEY_LEFT, KEY_HOME, KEY_END,
+        KEY_F1, KEY_F2, KEY_F3, KEY_F4};
+    if (pos + 2 >= pending.size())
+    {
+        if (!timed_out)
+            return INCOMPLETE;
+        // The sequence never finished, so it must have been Alt+O
+        pos += 2;
+        key = Key('O', KEY_ALT);
+        return COMPLETE;
+    }
+    char letter = pending[pos + 2];
+    pos += 3;
+    const char *letters = "ABCDHFPQRS";
+    const char *found = letter != 0 ? strchr(letters, letter) : 0;
+    if (!found)
+        return SKIPPED;
+    key = Key(letter_keys[found - letters]);
+    return COMPLETE;
+}
+
+/**
+ * Adds the bytes an xterm sends for a key, so keys can be read as
+ * characters too
+ * @param key the key
+ * @param bytes the string to add the bytes to
+ */
+void trio::detail::key_bytes(const Key &key, string &bytes)
+{
+    if (key.code == KEY_PASTE)
+    {
+        bytes += key.text;
+        return;
+    }
+    if (key.code == '\t' && key.mods == KEY_SHIFT)
+    {
+        bytes += "\033[Z";
+        return;
+    }
+    if (key.code < KEY_UP)
+    {
+        if (key.mods & KEY_ALT)
+            bytes += '\033';
+        utf8_append(bytes, key.code);
+        return;
+    }
+    // The letter or number that ends each key's sequence, from KEY_UP on
+    static const char letters[] = "ABCDHF";
+    static const int numbers[] = {2, 3, 5, 6, 11, 12, 13, 14, 15, 17, 18, 19, 20, 21, 23, 24};
+    unsigned int index = key.code - KEY_UP;
+    char sequence[16];
+    if (index < 6 && key.mods == 0)
+        snprintf(sequence, sizeof(sequence), "\033[%c", letters[index]);
+    else if (index < 6)
+        snprintf(sequence, sizeof(sequence), "\033[1;%u%c", key.mods + 1, letters[index]);
+    else if (key.mods == 0)
+        snprintf(sequence, sizeof(sequence), "\033[%d~", numbers[index - 6]);
+    else
+        snprintf(sequence, sizeof(sequence), "\033[%d;%u~", numbers[index - 6], key.mods + 1);
+    bytes += sequence;
+}
+
+#if defined(WINDOWS)
+/**
+ * Windows reports keys as events instead of bytes, so they are turned into
+ * the bytes an xterm would send and decoded the same way
+ * @param event the console key event
+ * @param bytes the string to add the bytes to
+ */
+void trio::detail::console_key(const KEY_EVENT_RECORD &event, string &bytes)
+{
+    DWORD state = event.dwControlKeyState;
+    bool ctrl = (state & (LEFT_CTRL_PRESSED | RIGHT_CTRL_PRESSED)) != 0;
+    bool alt = (state & (LEFT_ALT_PRESSED | RIGHT_ALT_PRESSED)) != 0;
+    if (event.uChar.UnicodeChar != 0)
+    {
+        // Ctrl+Alt is AltGr on many keyboards, which just types a character
+        key_bytes(Key(event.uChar.UnicodeChar, alt && !ctrl ? KEY_ALT : 0), bytes);
+        return;
+    }
+    unsigned int mods = (state & SHIFT_PRESSED ? KEY_SHIFT : 0) | (alt ? KEY_ALT : 0) | (ctrl ? KEY_CTRL : 0);
+    unsigned int code = 0;
+    switch (event.wVirtualKeyCode)
+    {
+    case VK_UP: code = KEY_UP; break;
+    case VK_DOWN: code = KEY_DOWN; break;
+    case VK_RIGHT: code = KEY_RIGHT; break;
+    case VK_LEFT: code = KEY_LEFT; break;
+    case VK_HOME: code = KEY_HOME; break;
+    case VK_END: code = KEY_END; break;
+    case VK_INSERT: code = KEY_INSERT; break;
+    case VK_DELETE: code = KEY_DELETE; break;
+    case VK_PRIOR: code = KEY_PAGE_UP; break;
+    case VK_NEXT: code = KEY_PAGE_DOWN; break;
+    default:
+        if (event.wVirtualKeyCode >= VK_F1 && event.wVirtualKeyCode <= VK_F12)
+            code = KEY_F1 + (event.wVirtualKeyCode - VK_F1);
+        break;
+    }
+    if (code != 0)
+        key_bytes(Key(code, mods), bytes);
+}
+#endif
+
+/**
+ * Waits for keyboard input and reads it
+ * @param bytes where to put the input
+ * @param size the most bytes to read
+ * @param ms how long to wait in milliseconds (forever if negative)
+ * @param stop signaled when the read should give up
+ * @return how many bytes were read, 0 at the end of input or when stopped,
+ * or -1 if the time ran out
+ */
+long trio::detail::read_keyboard(unsigned char *bytes, size_t size, int ms, StopSignal stop)
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+#if defined(WINDOWS)
+    HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+    HANDLE handles[2] = {input, stop};
+    while (true)
+    {
+        DWORD wait = INFINITE;
+        if (ms >= 0)
+        {
+            long long left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            wait = left > 0 ? (DWORD)left : 0;
+        }
+        DWORD which = WaitForMultipleObjects(stop != NULL ? 2 : 1, handles, FALSE, wait);
+        if (which == WAIT_TIMEOUT)
+            return -1;
+        if (which != WAIT_OBJECT_0)
+            return 0;
+        // Each event can turn into several bytes, so only take as many as
+        // are sure to fit
+        INPUT_RECORD records[32];
+        DWORD events = 0;
+        if (!ReadConsoleInputW(input, records, (DWORD)std::min<size_t>(32, size / 8), &events))
+            return 0;
+        string text;
+        for (DWORD i = 0; i < events; i++)
+        {
+            if (records[i].EventType == KEY_EVENT && records[i].Event.KeyEvent.bKeyDown)
+                console_key(records[i].Event.KeyEvent, text);
+        }
+        // Mouse, focus and key release events don't count as input
+        if (!text.empty())
+        {
+            memcpy(bytes, text.data(), std::min(text.size(), size));
+            return (long)std::min(text.size(), size);
+        }
+    }
+#else
+    struct pollfd fds[2];
+    fds[0].fd = 0;
+    fds[0].events = POLLIN;
+    fds[1].fd = stop;
+    fds[1].events = POLLIN;
+    while (true)
+    {
+        int wait = -1;
+        if (ms >= 0)
+        {
+            long long left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            wait = left > 0 ? (int)left : 0;
+        }
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        int ready = poll(fds, stop >= 0 ? 2 : 1, wait);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready < 0)
+        {
+            perror("poll()");
+            return 0;
+        }
+        if (ready == 0)
+            return -1;
+        if (fds[1].revents != 0)
+            return 0;
+        ssize_t count = read(0, bytes, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            perror("read()");
+        return count > 0 ? count : 0;
+    }
+#endif
+}
+
+/**
+ * Puts the terminal in raw mode and starts reading the keyboard on a new
+ * thread
+ */
+trio::detail::InputReader::InputReader() : stopping(false), finished(false), total_bytes(0), waiting(false)
+{
+#if defined(WINDOWS)
+    stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+#else
+    // Writing to this pipe wakes the thread up when it is time to stop
+    if (pipe(stop_pipe) < 0)
+    {
+        perror("pipe()");
+        stop_pipe[0] = stop_pipe[1] = -1;
+    }
+#endif
+    thread = std::thread(&InputReader::run, this);
+}
+
+/**
+ * Stops the reading thread, then the terminal goes back to normal when the
+ * RawMode member goes away
+ */
+trio::detail::InputReader::~InputReader()
+{
+    stopping = true;
+#if defined(WINDOWS)
+    SetEvent(stop_event);
+    thread.join();
+    CloseHandle(stop_event);
+#else
+    if (stop_pipe[1] >= 0 && write(stop_pipe[1], "", 1) < 0)
+        perror("write()");
+    thread.join();
+    if (stop_pipe[0] >= 0)
+    {
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+    }
+#endif
+}
+
+/**
+ * Takes a key that has been read, without waiting
+ * @param key the variable to read the key into
+ * @return whether there was a key
+ */
+bool trio::detail::InputReader::try_get(Key &key)
+{
+    return keys.pop(key);
+}
+
+/**
+ * Waits for a key to be read. The mutex is only used when there isn't a key
+ * ready, so polling every frame never blocks.
+ * @param key the variable to read the key into
+ * @param ms how long to wait in milliseconds (forever if negative)
+ * @return whether a key was read before the time ran out or input ended
+ */
+bool trio::detail::InputReader::get_for(Key &key, int ms)
+{
+    if (keys.pop(key))
+        return true;
+    if (ms == 0)
+        return false;
+    std::unique_lock<std::mutex> lock(wait_mutex);
+    waiting = true;
+    // Pairs with the fence in deliver, so either we see the key or the
+    // reader sees that we are waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto ready = [this]() { return !keys.empty() || finished.load(); };
+    if (ms < 0)
+        wakeup.wait(lock, ready);
+    else
+        wakeup.wait_for(lock, std::chrono::milliseconds(ms), ready);
+    waiting = false;
+    return keys.pop(key);
+}
+
+/**
+ * Reads keys until the IO object stops the reader or input ends
+ */
+void trio::detail::InputReader::run()
+{
+    KeyDecoder decoder;
+    unsigned char bytes[256];
+    Key key;
+#if defined(WINDOWS)
+    StopSignal stop = stop_event;
+#else
+    StopSignal stop = stop_pipe[0];
+#endif
+    while (true)
+    {
+        // A lone ESC only waits a moment to see if a sequence follows
+        long count = read_keyboard(bytes, sizeof(bytes), decoder.partial() ? escape_timeout_ms : -1, stop);
+        if (count == 0)
+            break;
+        if (count > 0)
+        {
+            decoder.feed(bytes, count);
+            TRIO_STAT(total_bytes.fetch_add(count, std::memory_order_relaxed));
+        }
+        while (decoder.next(key, count < 0))
+            deliver(key);
+    }
+    // Whatever is left at the end of input is still keys
+    while (!stopping && decoder.next(key, true))
+        deliver(key);
+
+    finished = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::lock_guard<std::mutex> lock(wait_mutex);
+    wakeup.notify_all();
+}
+
+/**
+ * How many bytes the thread has read from the keyboard so far
+ * @return the number of bytes read
+ */
+size_t trio::detail::InputReader::bytes_read() const
+{
+    return total_bytes.load(std::memory_order_relaxed);
+}
+
+/**
+ * Queues a key for the IO object, and wakes it up if it is waiting
+ * @param key the key that was read
+ */
+void trio::detail::InputReader::deliver(const Key &key)
+{
+    // Nothing is thrown away if the program falls behind, we just wait
+    while (!keys.push(key))
+    {
+        if (stopping)
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // Pairs with the fence in get_for, so either the consumer sees the key
+    // or we see that it is waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex);
+        wakeup.notify_one();
+    }
+}
+
+/* .d88888b  oo          dP           8888ba.88ba             dP   dP                      dP          
+ * 88.    "'             88           88  `8b  `8b            88   88                      88          
+ * `Y88888b. dP 88d888b. 88  .dP      88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ *       `8b 88 88'  `88 88888"       88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * d8'   .8P 88 88    88 88  `8b.     88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ *  Y88888P  dP dP    dP dP   `YP     dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * oooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+trio::Sink::~Sink()
+{
+}
+
+/**
+ * Sends two runs of bytes on, one after the other. Sinks that can send both
+ * at once (like FdSink, with writev) override this.
+ * @param first the first run of bytes
+ * @param first_size how many bytes are in the first run
+ * @param second the run of bytes that goes after it
+ * @param second_size how many bytes are in the second run
+ */
+void trio::Sink::write(const char *first, size_t first_size, const char *second, size_t second_size)
+{
+    write(first, first_size);
+    write(second, second_size);
+}
+
+/**
+ * Pushes out anything the Sink is holding on to. Sinks that don't hold on
+ * to anything don't need to override this.
+ */
+void trio::Sink::flush()
+{
+}
+
+/**
+ * Gets the size of the terminal behind the Sink. The default is to not
+ * know, which lets text wrap and scroll where it likes.
+ * @param rows set to the number of rows, if the size is known
+ * @param cols set to the number of columns, if the size is known
+ * @return whether the size is known
+ */
+bool trio::Sink::size(unsigned short &rows, unsigned short &cols)
+{
+    (void)rows;
+    (void)cols;
+    return false;
+}
+
+/**
+ * Creates a StreamSink that sends output to a stream
+ * @param out the stream, which must outlive the StreamSink
+ */
+trio::StreamSink::StreamSink(ostream &out) : out(&out), wout(NULL)
+{
+}
+
+/**
+ * Creates a StreamSink that sends output to a wide stream
+ * @param wout the wide stream, which must outlive the StreamSink
+ */
+trio::StreamSink::StreamSink(wostream &wout) : out(NULL), wout(&wout)
+{
+}
+
+/**
+ * Sends bytes to the stream, converting them to wide characters for a wide
+ * stream. The stream is not flushed.
+ * @param text the bytes to send
+ * @param size how many bytes to send
+ */
+void trio::StreamSink::write(const char *text, size_t size)
+{
+    if (wout != NULL)
+        detail::write_wide(*wout, text, size);
+    else
+        out->write(text, size);
+}
+
+/**
+ * Flushes the stream
+ */
+void trio::StreamSink::flush()
+{
+    if (wout != NULL)
+        wout->flush();
+    else
+        out->flush();
+}
+
+/**
+ * Gets the size of the terminal, if the stream is cout or wcout (and they
+ * go to a terminal)
+ * @param rows set to the number of rows, if the size is known
+ * @param cols set to the number of columns, if the size is known
+ * @return whether the size is known
+ */
+bool trio::StreamSink::size(unsigned short &rows, unsigned short &cols)
+{
+    if (out != &cout && wout != &wcout)
+        return false;
+#if defined(WINDOWS)
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info))
+        return false;
+    rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+    cols = info.srWindow.Right - info.srWindow.Left + 1;
+    return true;
+#else
+    return FdSink(STDOUT_FILENO).size(rows, cols);
+#endif
+}
+
+/**
+ * Creates an FdSink that writes to a file descriptor
+ * @param fd the file descriptor, which is left open
+ */
+trio::FdSink::FdSink(int fd) : fd(fd)
+{
+}
+
+/**
+ * Writes bytes to the file descriptor, retrying until they are all written
+ * (or it fails). Anything waiting in cout or stdout is sent first when the
+ * descriptor is stdout, so output stays in order.
+ * @param text the bytes to write
+ * @param size how many bytes to write
+ */
+void trio::FdSink::write(const char *text, size_t size)
+{
+#if defined(WINDOWS)
+    if (fd == _fileno(stdout))
+#else
+    if (fd == STDOUT_FILENO)
+#endif
+    {
+        cout.flush();
+        fflush(stdout);
+    }
+    while (size > 0)
+    {
+#if defined(WINDOWS)
+        const int sent = _write(fd, text, (unsigned int)size);
+#else
+        const ssize_t sent = ::write(fd, text, size);
+#endif
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("write()");
+            return;
+        }
+        text += sent;
+        size -= sent;
+    }
+}
+
+/**
+ * Writes two runs of bytes to the file descriptor with a single writev, as
+ * long as the system takes them all at once
+ * @param first the first run of bytes
+ * @param first_size how many bytes are in the first run
+ * @param second the run of bytes that goes after it
+ * @param second_size how many bytes are in the second run
+ */
+void trio::FdSink::write(const char *first, size_t first_size, const char *second, size_t second_size)
+{
+#if defined(WINDOWS)
+    // There is no writev on Windows
+    write(first, first_size);
+    write(second, second_size);
+#else
+    if (fd == STDOUT_FILENO)
+    {
+        cout.flush();
+        fflush(stdout);
+    }
+    struct iovec pieces[2];
+    pieces[0].iov_base = const_cast<char *>(first);
+    pieces[0].iov_len = first_size;
+    pieces[1].iov_base = const_cast<char *>(second);
+    pieces[1].iov_len = second_size;
+    ssize_t sent;
+    do
+    {
+        sent = ::writev(fd, pieces, 2);
+    } while (sent < 0 && errno == EINTR);
+    if (sent < 0)
+    {
+        perror("writev()");
+        return;
+    }
+    // Whatever didn't fit is written the slow way
+    if ((size_t)sent < first_size)
+    {
+        write(first + sent, first_size - sent);
+        sent = first_size;
+    }
+    write(second + (sent - first_size), second_size - (sent - first_size));
+#endif
+}
+
+/**
+ * Gets the size of the terminal the file descriptor goes to
+ * @param rows set to the number of rows, if the size is known
+ * @param cols set to the number of columns, if the size is known
+ * @return whether the size is known (false if it isn't a terminal)
+ */
+bool trio::FdSink::size(unsigned short &rows, unsigned short &cols)
+{
+#if defined(WINDOWS)
+    HANDLE handle = (HANDLE)_get_osfhandle(fd);
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (handle == INVALID_HANDLE_VALUE || !GetConsoleScreenBufferInfo(handle, &info))
+        return false;
+    rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+    cols = info.srWindow.Right - info.srWindow.Left + 1;
+#else
+    struct winsize ws;
+    if (ioctl(fd, TIOCGWINSZ, &ws) != 0)
+        return false;
+    rows = ws.ws_row;
+    cols = ws.ws_col;
+#endif
+    return true;
+}
+
+/**
+ * Creates an empty MemorySink
+ * @param rows how many rows to claim the terminal has (0 for no terminal)
+ * @param cols how many columns to claim the terminal has (0 for no
+ * terminal)
+ */
+trio::MemorySink::MemorySink(unsigned short rows, unsigned short cols) : n_rows(rows), n_cols(cols)
+{
+}
+
+/**
+ * Adds bytes to the end of what was sent
+ * @param text the bytes to add
+ * @param size how many bytes to add
+ */
+void trio::MemorySink::write(const char *text, size_t size)
+{
+    bytes.append(text, size);
+}
+
+/**
+ * Adds two runs of bytes to the end of what was sent, making room for both
+ * at once
+ * @param first the first run of bytes
+ * @param first_size how many bytes are in the first run
+ * @param second the run of bytes that goes after it
+ * @param second_size how many bytes are in the second run
+ */
+void trio::MemorySink::write(const char *first, size_t first_size, const char *second, size_t second_size)
+{
+    bytes.reserve(bytes.size() + first_size + second_size);
+    bytes.append(first, first_size);
+    bytes.append(second, second_size);
+}
+
+/**
+ * Gets the size the MemorySink was created with
+ * @param rows set to the number of rows
+ * @param cols set to the number of columns
+ * @return false if the MemorySink was created without a size
+ */
+bool trio::MemorySink::size(unsigned short &rows, unsigned short &cols)
+{
+    if (n_rows == 0 || n_cols == 0)
+        return false;
+    rows = n_rows;
+    cols = n_cols;
+    return true;
+}
+
+/**
+ * Everything that was sent since the MemorySink was made or cleared
+ * @return the bytes that were sent
+ */
+const std::string &trio::MemorySink::data() const
+{
+    return bytes;
+}
+
+/**
+ * Forgets what was sent. The memory is kept, so a MemorySink that is
+ * cleared every frame stops allocating once it has seen the biggest frame.
+ */
+void trio::MemorySink::clear()
+{
+    bytes.clear();
+}
+
+/* ██╗ ██████╗     ███╗   ███╗███████╗████████╗██╗  ██╗ ██████╗ ██████╗ ███████╗
+ * ██║██╔═══██╗    ████╗ ████║██╔════╝╚══██╔══╝██║  ██║██╔═══██╗██╔══██╗██╔════╝
+ * ██║██║   ██║    ██╔████╔██║█████╗     ██║   ███████║██║   ██║██║  ██║███████╗
+ * ██║██║   ██║    ██║╚██╔╝██║██╔══╝     ██║   ██╔══██║██║   ██║██║  ██║╚════██║
+ * ██║╚██████╔╝    ██║ ╚═╝ ██║███████╗   ██║   ██║  ██║╚██████╔╝██████╔╝███████║
+ * ╚═╝ ╚═════╝     ╚═╝     ╚═╝╚══════╝   ╚═╝   ╚═╝  ╚═╝ ╚═════╝ ╚═════╝ ╚══════╝
+ * ANSI Shadow font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Default constructor for the IO object. It prints to the terminal: on *nix
+ * by writing to stdout directly (after anything printed with cout or
+ * printf), and on Windows through the console.
+ */
+trio::IO::IO() : color_wanted(0, 0), color_applied(0, 0)
+{
+#if defined(WINDOWS)
+    own_sink = std::make_shared<StreamSink>(wcout);
+    console = true;
+#else
+    own_sink = std::make_shared<FdSink>(STDOUT_FILENO);
+    console = false;
+#endif
+    sink = own_sink.get();
+    init();
+}
+
+/**
+ * Creates an IO object that prints to a stream. Everything, including
+ * colors, cursor moves and clearing, is sent to the stream as escape
+ * sequences.
+ * @param out the stream, which must outlive the IO object
+ */
+trio::IO::IO(ostream &out) : color_wanted(0, 0), color_applied(0, 0)
+{
+    own_sink = std::make_shared<StreamSink>(out);
+    sink = own_sink.get();
+    console = false;
+    init();
+}
+
+/**
+ * Creates an IO object that prints to a wide stream. Text is converted from
+ * UTF-8 to wide characters. On Windows, printing to wcout goes through the
+ * console like the default IO object does.
+ * @param wout the wide stream, which must outlive the IO object
+ */
+trio::IO::IO(wostream &wout) : color_wanted(0, 0), color_applied(0, 0)
+{
+    own_sink = std::make_shared<StreamSink>(wout);
+    sink = own_sink.get();
+#if defined(WINDOWS)
+    console = &wout == &wcout;
+#else
+    console = false;
+#endif
+    init();
+}
+
+/**
+ * Creates an IO object that prints to a Sink, like an FdSink for a
+ * pseudo-terminal or a MemorySink for tests. Everything, including colors,
+ * cursor moves and clearing, goes through the Sink.
+ * @param sink the Sink, which must outlive the IO object
+ */
+trio::IO::IO(Sink &sink) : color_wanted(0, 0), color_applied(0, 0)
+{
+    this->sink = &sink;
+    console = false;
+    init();
+}
+
+/**
+ * Sets up everything the constructors share, once the sink is chosen
+ */
+void trio::IO::init()
+{
+#if defined(WINDOWS)
+    windows_setup = false;
+#endif
+    buffered = false;
+    buffer_limit = 65536;
+    // We don't know what color the terminal is using until we set it
+    color_pending = false;
+    color_known = false;
+    reset_stats();
+    // Nor do we know where the cursor is
+    cursor_row = 0;
+    cursor_col = 0;
+    cursor_known = false;
+    term_rows = 0;
+    term_cols = 0;
+    size_checked = false;
+    size_resizes = 0;
+    size_seen = false;
+    seen_rows = 0;
+    seen_cols = 0;
+    culling = true;
+    positioned = false;
+    view_row = 0;
+    view_col = 0;
+#if !defined(WINDOWS)
+    detail::watch_resize();
+#endif
+    scroll_top = 0;
+    scroll_bottom = 0;
+    scroll_set = false;
+    input_head = 0;
+    input_size = 0;
+    key_head = 0;
+    // The console API has no scroll regions, and only 8 colors
+    scrolling = false;
+    depth = COLORS_8;
+    if (!console)
+    {
+        // Terminals that can't even move the cursor can't scroll regions
+        // either
+        const char *term = getenv("TERM");
+        scrolling = term != NULL && *term != '\0' && strcmp(term, "dumb") != 0;
+        // Terminals don't say how many colors they have, but these are the
+        // usual hints
+        const char *colorterm = getenv("COLORTERM");
+        if (colorterm != NULL && (strcmp(colorterm, "truecolor") == 0 || strcmp(colorterm, "24bit") == 0))
+            depth = COLORS_TRUE;
+        else if (term != NULL && strstr(term, "256color") != NULL)
+            depth = COLORS_256;
+    }
+}
+
+/**
+ * Sends any buffered output before the IO object goes away
+ */
+trio::IO::~IO()
+{
+    stop_input();
+    // A scroll region left behind would keep confining the shell
+    if (scroll_set)
+        reset_scroll_region();
+    flush();
+}
+
+/* dP                               dP      8888ba.88ba             dP   dP                      dP          
+ * 88                               88      88  `8b  `8b            88   88                      88          
+ * 88 88d888b.  88d888b. dP    dP d8888P    88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ * 88 88'  `88  88'  `88 88    88   88      88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * 88 88    88  88.  .88 88.  .88   88      88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ * dP dP    dP  88Y888P' `88888P'   dP      dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * oooooooooooo~88~oooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ *              dP                                                                                           
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Gets a single character from stdin.
+ * Input is unbuffered, echoless, blocking. For non-blocking, use
+ * try_get().
+ * @param ch_var the variable to read a character into
+ * @return this object (for chaining inputs)
+ */
+trio::IO &trio::IO::operator>>(unsigned char &ch_var)
+{
+    // Anything buffered should be visible before we wait for the user
+    flush();
+    TRIO_STAT(detail::StatTimer timer(counters.input_wait_ms));
+
+    // When the keyboard is read in the background, take keys from there
+    if (reader)
+    {
+        while (key_head >= key_bytes.size())
+        {
+            Key key;
+            if (!reader->get_for(key, -1))
+            {
+                ch_var = 0;
+                return *this;
+            }
+            key_bytes.clear();
+            key_head = 0;
+            detail::key_bytes(key, key_bytes);
+        }
+        ch_var = key_bytes[key_head++];
+        return *this;
+    }
+
+    // Use input that was already read, if there is any
+    if (input_head < input_size || (RawMode::active() && fill_input()))
+    {
+        ch_var = input_queue[input_head++];
+        return *this;
+    }
+
+#if defined(WINDOWS)
+    // Setup Windows if we haven't yet.
+    if (!windows_setup)
+        setupWindows();
+
+    // Keeps track of the console mode we started with
+    DWORD mode;
+    // Get the current mode so we can restore it later
+    GetConsoleMode(stdin_terminal, &mode);
+    // Set the console mode to unbuffered and echoless
+    SetConsoleMode(stdin_terminal, 0);
+
+    //ch_var = std::cin.get();
+    DWORD cc;
+    TCHAR c = 0;
+    ReadConsole(stdin_terminal, &c, 1, &cc, NULL);
+    ch_var = (unsigned char)c;
+    TRIO_STAT(counters.input_bytes += cc);
+
+    // Restore the original console mode
+    SetConsoleMode(stdin_terminal, mode);
+#else
+
+    // borrowed from anonymous stackoverflow user at
+    // https://stackoverflow.com/questions/421860/capture-characters-from-standard-input-without-waiting-for-enter-to-be-pressed
+    char buf = 0;
+    struct termios old = {0};
+    if (tcgetattr(0, &old) < 0)
+        perror("tcsetattr()");
+    old.c_lflag &= ~ICANON;
+    old.c_lflag &= ~ECHO;
+    old.c_cc[VMIN] = 1;
+    old.c_cc[VTIME] = 0;
+    if (tcsetattr(0, TCSANOW, &old) < 0)
+        perror("tcsetattr ICANON");
+    ssize_t count = read(0, &buf, 1);
+    if (count < 0)
+        perror("read()");
+    TRIO_STAT(counters.input_bytes += count > 0 ? count : 0);
+    old.c_lflag |= ICANON;
+    old.c_lflag |= ECHO;
+    if (tcsetattr(0, TCSADRAIN, &old) < 0)
+        perror("tcsetattr ~ICANON");
+    ch_var = buf;
+
+#endif
+    return *this;
+}
+
+/**
+ * Reads all of the input that is waiting into the input queue, blocking
+ * until there is at least one character. This is only used in raw mode,
+ * where the terminal doesn't need to be switched for each read.
+ * @return whether anything was read (false at the end of input)
+ */
+bool trio::IO::fill_input()
+{
+    input_head = 0;
+    input_size = 0;
+#if defined(WINDOWS)
+    if (!windows_setup)
+        setupWindows();
+    TCHAR chars[sizeof(input_queue)];
+    DWORD count = 0;
+    if (!ReadConsole(stdin_terminal, chars, sizeof(input_queue), &count, NULL))
+        return false;
+    for (DWORD i = 0; i < count; i++)
+        input_queue[i] = (unsigned char)chars[i];
+    input_size = count;
+    TRIO_STAT(counters.input_bytes += count);
+#else
+    ssize_t count;
+    do
+    {
+        count = read(0, input_queue, sizeof(input_queue));
+    } while (count < 0 && errno == EINTR);
+    if (count < 0)
+        perror("read()");
+    if (count <= 0)
+        return false;
+    input_size = count;
+    TRIO_STAT(counters.input_bytes += count);
+#endif
+    return true;
+}
+
+/**
+ * Gets a single character from stdin.
+ * Input is unbuffered, echoless, blocking. For non-blocking, use
+ * try_get().
+ * @param ch_var the variable to read a character into 
+ * @return this object (for chaining inputs)
+ */
+trio::IO &trio::IO::operator>>(char &ch_var)
+{
+    unsigned char temp;
+    *this >> temp;
+    ch_var = (char)temp;
+    return *this;
+}
+
+/**
+ * Gets a single key from stdin, like a character, an arrow key or a paste.
+ * Input is unbuffered, echoless, blocking. For non-blocking, use
+ * try_get().
+ * @param key the variable to read a key into
+ * @return this object (for chaining inputs)
+ */
+trio::IO &trio::IO::operator>>(Key &key)
+{
+    if (reader)
+    {
+        flush();
+        TRIO_STAT(detail::StatTimer timer(counters.input_wait_ms));
+        if (!reader->get_for(key, -1))
+            key = Key();
+        return *this;
+    }
+
+    // Without a session of the program's own this one is only for this
+    // key, which also turns bracketed paste on (see RawMode)
+    RawMode raw;
+    // Anything buffered should be visible before we wait for the user
+    flush();
+    TRIO_STAT(detail::StatTimer timer(counters.input_wait_ms));
+
+    // Start with input that was already read, if there is any
+    detail::KeyDecoder decoder;
+    decoder.feed(input_queue + input_head, input_size - input_head);
+    long count = 0;
+    while (!decoder.next(key, count < 0))
+    {
+        // A lone ESC only waits a moment to see if a sequence follows
+        count = detail::read_keyboard(input_queue, sizeof(input_queue), decoder.partial() ? detail::escape_timeout_ms : -1, detail::no_stop);
+        if (count == 0)
+        {
+            // The end of input, so take whatever is left
+            if (!decoder.next(key, true))
+                key = Key();
+            break;
+        }
+        if (count > 0)
+        {
+            decoder.feed(input_queue, count);
+            TRIO_STAT(counters.input_bytes += count);
+        }
+    }
+    // Keep anything typed after the key for the next read
+    string rest = decoder.rest();
+    input_head = 0;
+    input_size = std::min(rest.size(), sizeof(input_queue));
+    memcpy(input_queue, rest.data(), input_size);
+    return *this;
+}
+
+/**
+ * Gets a single key from stdin as text. Characters are given as
+ * themselves, other keys by name (like "Up" or "Ctrl+F5") and pastes as
+ * the text that was pasted.
+ * Input is unbuffered, echoless, blocking. For non-blocking, use
+ * try_get().
+ * @param str_var the variable to point at the key's text, which stays
+ * valid until the next key is read
+ * @return this object (for chaining inputs)
+ */
+trio::IO &trio::IO::operator>>(char *&str_var)
+{
+    Key key;
+    *this >> key;
+    key_text = key.code == KEY_PASTE ? key.text : key.name();
+    str_var = &key_text[0];
+    return *this;
+}
+
+/**
+ * Gets a key if one has been typed, without waiting. The first call starts
+ * reading the keyboard on a background thread.
+ * @param key the variable to read a key into
+ * @return whether a key was read
+ */
+bool trio::IO::try_get(Key &key)
+{
+    return start_input().try_get(key);
+}
+
+/**
+ * Waits for a key to be typed, reading the keyboard on a background thread
+ * @param key the variable to read a key into
+ * @param ms the longest time to wait in milliseconds (forever if negative)
+ * @return whether a key was read before the time ran out
+ */
+bool trio::IO::get_for(Key &key, int ms)
+{
+    detail::InputReader &keys = start_input();
+    // Anything buffered should be visible before we wait for the user
+    if (ms != 0)
+        flush();
+    return keys.get_for(key, ms);
+}
+
+/**
+ * Stops reading the keyboard in the background. The terminal goes back to
+ * normal once no copy of this IO object is using the reader.
+ * @return this object (for chaining)
+ */
+trio::IO &trio::IO::stop_input()
+{
+#if !defined(TRIO_NO_STATS)
+    if (reader)
+        counters.input_bytes += reader->bytes_read() - reader_bytes_counted;
+#endif
+    reader_bytes_counted = 0;
+    reader.reset();
+    return *this;
+}
+
+/**
+ * Starts reading the keyboard on a background thread if it isn't already
+ * @return the background reader
+ */
+trio::detail::InputReader &trio::IO::start_input()
+{
+    if (!reader)
+        reader = std::make_shared<detail::InputReader>();
+    return *reader;
+}
+
+/*  .88888.             dP                        dP      8888ba.88ba             dP   dP                      dP          
+ * d8'   `8b            88                        88      88  `8b  `8b            88   88                      88          
+ * 88     88 dP    dP d8888P  88d888b. dP    dP d8888P    88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ * 88     88 88    88   88    88'  `88 88    88   88      88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * Y8.   .8P 88.  .88   88    88.  .88 88.  .88   88      88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ *  `8888P'  `88888P'   dP    88Y888P' `88888P'   dP      dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * oooooooooooooooooooooooooo~88~oooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ *                            dP                                                                                           
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Prints a string to the terminal and interprets any color codes found
+ * @param text the string to print to the terminal
+ * @return a reference to this IO object, to account for chained outputs
+ */
+trio::IO &trio::IO::operator<<(const string &text)
+{
+#if defined(WINDOWS)
+    // Setup Windows if we haven't yet.
+    if (!windows_setup)
+        setupWindows();
+#endif
+
+    // Scan the string once, printing each span of text and changing colors
+    // as codes are found (see detail::scan_markup for the rules)
+    MarkupPrinter printer = {*this};
+    detail::scan_markup(text.data(), text.size(), printer);
+    end_output();
+
+    // Return this IO object (for any chained outputs)
+    return *this;
+}
+
+/**
+ * Prints a string whose color codes were already parsed into a Markup
+ * object. The output is the same as printing the original string.
+ * @param markup the parsed string to print to the terminal
+ * @return a reference to this IO object, to account for chained outputs
+ */
+trio::IO &trio::IO::operator<<(const Markup &markup)
+{
+    print_entries(markup.text().data(), markup.entries().data(), markup.entries().size());
+    end_output();
+    return *this;
+}
+
+/**
+ * Prints already parsed markup, changing colors and printing each span of
+ * text in order
+ * @param text the printable text the entries point into
+ * @param entries the color changes and spans of text
+ * @param count how many entries there are
+ */
+void trio::IO::print_entries(const char *text, const MarkupEntry *entries, size_t count)
+{
+#if defined(WINDOWS)
+    // Setup Windows if we haven't yet.
+    if (!windows_setup)
+        setupWindows();
+#endif
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (entries[i].color)
+            set_color(Color(entries[i].fg, entries[i].bg));
+        if (entries[i].length > 0)
+        {
+            put_text(text + entries[i].offset, entries[i].length);
+        }
+    }
+}
+
+/**
+ * Prints a character to the terminal
+ * @param letter the character to print to the terminal
+ * @return a reference to this IO object, to account for chained outputs
+ */
+trio::IO &trio::IO::operator<<(const char &letter)
+{
+#if defined(WINDOWS)
+    // Setup Windows if we haven't yet.
+    if (!windows_setup)
+        setupWindows();
+#endif
+
+    put_text(&letter, 1);
+    end_output();
+    return *this;
+}
+
+/**
+ * Prints an integer to the terminal
+ * @param number the integer to print to the terminal
+ * @return a reference to this IO object, to account for chained outputs
+ */
+trio::IO &trio::IO::operator<<(const int &number)
+{
+#if defined(WINDOWS)
+    // Setup Windows if we haven't yet.
+    if (!windows_setup)
+        setupWindows();
+#endif
+
+    char digits[16];
+    int size = snprintf(digits, sizeof(digits), "%d", number);
+    put_text(digits, size);
+    end_output();
+    return *this;
+}
+
+/**
+ * Prints a double to the terminal
+ * @param number the double to print to the terminal
+ * @return a reference to this IO object, to account for chained outputs
+ */
+trio::IO &trio::IO::operator<<(const double &number)
+{
+#if defined(WINDOWS)
+    // Setup Windows if we haven't yet.
+    if (!windows_setup)
+        setupWindows();
+#endif
+
+    // "%g" matches how streams print doubles by default
+    char digits[32];
+    int size = snprintf(digits, sizeof(digits), "%g", number);
+    put_text(digits, size);
+    end_output();
+    return *this;
+}
+
+/**
+ * Prints text to the terminal exactly as given, without interpreting any
+ * color codes
+ * @param text the characters to print to the terminal
+ * @param size how many characters to print
+ * @return a reference to this IO object, to account for chained outputs
+ */
+trio::IO &trio::IO::write(const char *text, size_t size)
+{
+#if defined(WINDOWS)
+    // Setup Windows if we haven't yet.
+    if (!windows_setup)
+        setupWindows();
+#endif
+
+    put_text(text, size);
+    end_output();
+    return *this;
+}
+
+/**
+ * Collects text in the buffer, to be sent to the sink by flush() (when
+ * unbuffered, that happens at the end of each operation). Big text is sent
+ * straight from where it is, along with whatever was waiting before it, so
+ * it isn't copied.
+ * @param text the characters to send
+ * @param size how many characters to send
+ */
+void trio::IO::put(const char *text, size_t size)
+{
+    if (size == 0)
+        return;
+    if (size >= 4096 && (!buffered || buffer.size() + size >= buffer_limit))
+    {
+        send(text, size);
+        return;
+    }
+    buffer.append(text, size);
+}
+
+/**
+ * Sends the buffer and some text after it to the sink in one write (or a
+ * single writev, for an FdSink), like flush() does with the buffer alone
+ * @param text the characters to send after the buffer
+ * @param size how many characters to send after the buffer
+ */
+void trio::IO::send(const char *text, size_t size)
+{
+    if (buffer.empty() && size == 0)
+        return;
+    TRIO_STAT(counters.writes++);
+    TRIO_STAT(counters.bytes_written += buffer.size() + size);
+    if (buffer.empty())
+        sink->write(text, size);
+    else if (size == 0)
+        sink->write(buffer.data(), buffer.size());
+    else
+        sink->write(buffer.data(), buffer.size(), text, size);
+    sink->flush();
+    buffer.clear();
+}
+
+/**
+ * Sends printable text: applies any waiting color change first and keeps
+ * track of where the text leaves the cursor.
+ * @param text the characters to send
+ * @param size how many characters to send
+ */
+void trio::IO::put_text(const char *text, size_t size)
+{
+    if (size == 0)
+        return;
+    if (positioned)
+    {
+        put_visible(text, size);
+        return;
+    }
+    apply_color();
+    put(text, size);
+    advance_cursor(text, size);
+}
+
+/**
+ * Updates where we believe the cursor is after printing some text, using
+ * char_width() for characters outside of ASCII. Anything we can't be sure
+ * about (control characters, wrapping past the edge of the terminal) makes
+ * the position unknown, so the next move is absolute.
+ * @param text the characters that were printed
+ * @param size how many characters were printed
+ */
+void trio::IO::advance_cursor(const char *text, size_t size)
+{
+#if defined(WINDOWS)
+    // Cursor moves are API calls on the console, so tracking text isn't
+    // worth it
+    if (console)
+    {
+        cursor_known = false;
+        return;
+    }
+#endif
+    if (!cursor_known)
+        return;
+    check_size();
+    for (size_t i = 0; i < size;)
+    {
+        const unsigned char ch = (unsigned char)text[i];
+        if (ch >= 0x20 && ch < 0x7F)
+        {
+            cursor_col++;
+            i++;
+        }
+        else if (ch == '\n')
+        {
+            // At the bottom of the terminal (or of the scroll region) a
+            // newline scrolls instead
+            if (scroll_set ? cursor_row != scroll_bottom : term_rows == 0 || cursor_row + 1 < term_rows)
+                cursor_row++;
+            cursor_col = 0;
+            i++;
+        }
+        else if (ch == '\r')
+        {
+            cursor_col = 0;
+            i++;
+        }
+        else if (ch >= 0x80)
+        {
+            // Wide characters take two columns and combining marks none.
+            // Broken UTF-8, C1 controls, and wide characters the terminal
+            // would wrap early leave us guessing.
+            const unsigned int code_point = utf8_next(text, size, i);
+            const int width = char_width(code_point);
+            if (code_point == 0xFFFD || code_point < 0xA0 || (term_cols != 0 && cursor_col + width > term_cols))
+            {
+                cursor_known = false;
+                return;
+            }
+            cursor_col += width;
+        }
+        else
+        {
+            cursor_known = false;
+            return;
+        }
+        // Reaching the right edge means the next character wraps
+        if (term_cols != 0 && cursor_col >= term_cols)
+        {
+            cursor_known = false;
+            return;
+        }
+    }
+}
+
+/**
+ * Asks the sink for the terminal's size the first time it is needed, and
+ * again whenever it has been resized since. If output isn't going to a
+ * terminal the size stays 0 (unknown), which is fine since nothing will
+ * wrap.
+ */
+void trio::IO::check_size()
+{
+#if defined(WINDOWS)
+    if (size_checked)
+        return;
+#else
+    // SIGWINCH counts resizes, so the size only has to be asked for again
+    // once the count changes
+    const unsigned int resizes = detail::resize_count().load(std::memory_order_relaxed);
+    if (size_checked && resizes == size_resizes)
+        return;
+    size_resizes = resizes;
+#endif
+    unsigned short rows = 0;
+    unsigned short cols = 0;
+    if (!sink->size(rows, cols))
+    {
+        rows = 0;
+        cols = 0;
+    }
+    // Terminals move (or rewrap) the text when they are resized
+    if (size_checked && (rows != term_rows || cols != term_cols))
+        cursor_known = false;
+    size_checked = true;
+    term_rows = rows;
+    term_cols = cols;
+}
+
+/**
+ * Gets the number of rows the terminal has. The size is asked for once and
+ * kept up to date when the terminal is resized.
+ * @return the number of rows, or 0 if output isn't going to a terminal
+ */
+unsigned short trio::IO::rows()
+{
+    check_size();
+    return term_rows;
+}
+
+/**
+ * Gets the number of columns the terminal has. The size is asked for once
+ * and kept up to date when the terminal is resized.
+ * @return the number of columns, or 0 if output isn't going to a terminal
+ */
+unsigned short trio::IO::cols()
+{
+    check_size();
+    return term_cols;
+}
+
+/**
+ * Whether the terminal changed size since the last time this was asked. The
+ * first call only remembers the size. On *nix, resizes are noticed through
+ * SIGWINCH, so this is only an atomic load until the terminal really is
+ * resized. Windows has no such signal, so the size is asked for every time.
+ * @return true if the size is different now
+ */
+bool trio::IO::resized()
+{
+#if defined(WINDOWS)
+    size_checked = false;
+#endif
+    check_size();
+    if (!size_seen)
+    {
+        size_seen = true;
+        seen_rows = term_rows;
+        seen_cols = term_cols;
+    }
+    if (term_rows == seen_rows && term_cols == seen_cols)
+        return false;
+    seen_rows = term_rows;
+    seen_cols = term_cols;
+    return true;
+}
+
+/**
+ * Turns culling on or off. With culling on, a Point outside of the terminal
+ * doesn't move the cursor, and the rest of the line printed after a Point
+ * only sends what lands on the terminal: text past the right edge is cut
+ * off instead of wrapping, and nothing is sent while the position is off of
+ * the terminal (below it, until the next Point). Culling ends at the
+ * newline that ends the Point's line, so the lines after it wrap and scroll
+ * like text printed without a Point. Turn culling off to get the
+ * terminal's own wrapping back everywhere.
+ * @param enabled whether to cull
+ * @return this object, for chaining
+ */
+trio::IO &trio::IO::set_culling(bool enabled)
+{
+    culling = enabled;
+    if (!enabled)
+        positioned = false;
+    return *this;
+}
+
+/**
+ * Sends the parts of some text that land on the terminal, starting from the
+ * position of the last Point. Only the text that is sent is formatted
+ * (colored and tracked); the rest is skipped over. Culling covers the
+ * Point's line: the first newline on the terminal ends it, and is sent
+ * along with the rest of the text as usual. Below the terminal nothing is
+ * sent until the next Point. Control characters other than newlines and
+ * carriage returns do things that can't be followed, so they end culling
+ * too.
+ * @param text the characters to print
+ * @param size how many characters to print
+ */
+void trio::IO::put_visible(const char *text, size_t size)
+{
+#if defined(WINDOWS)
+    // Without tracking text (see advance_cursor) only a Point off of the
+    // console can be culled, and everything after it is
+    if (console)
+        return;
+#endif
+    const char *const end = text + size;
+    while (text < end)
+    {
+        // Find the end of this line, and the end of the part that fits
+        const char *pos = text;
+        const char *fits = text;
+        bool full = view_row >= term_rows;
+        unsigned int col = view_col;
+        while (pos < end && *pos != '\n' && *pos != '\r')
+        {
+            const unsigned char ch = (unsigned char)*pos;
+            if (ch < 0x20 || ch == 0x7F)
+                break;
+            size_t step = 1;
+            int width = 1;
+            if (ch >= 0x80)
+            {
+                step = 0;
+                width = char_width(utf8_next(pos, end - pos, step));
+            }
+            // Once something doesn't fit, nothing after it on the row does
+            if (col + width > term_cols)
+                full = true;
+            col += width;
+            pos += step;
+            if (!full)
+                fits = pos;
+        }
+        if (fits > text)
+        {
+            move_cursor(view_row, view_col);
+            apply_color();
+            put(text, fits - text);
+            advance_cursor(text, fits - text);
+        }
+        view_col = col;
+        text = pos;
+        if (text == end)
+            return;
+        if (*text == '\n' && view_row < term_rows)
+        {
+            // Culling only lasts for the Point's line: the newline and
+            // everything after it wrap and scroll like any other text
+            positioned = false;
+            move_cursor(view_row, 0);
+            apply_color();
+            put(text, end - text);
+            advance_cursor(text, end - text);
+            return;
+        }
+        if (*text == '\n')
+        {
+            // Below the terminal, where the newline would have scrolled
+            // lines that were never sent
+            view_row++;
+            view_col = 0;
+        }
+        else if (*text == '\r')
+            view_col = 0;
+        else
+        {
+            positioned = false;
+            if (view_row < term_rows && view_col < term_cols)
+            {
+                move_cursor(view_row, view_col);
+                apply_color();
+                put(text, end - text);
+                advance_cursor(text, end - text);
+            }
+            return;
+        }
+        text++;
+    }
+}
+
+/**
+ * Finishes an output operation. Unbuffered output is sent to the sink right
+ * away (along with any color change still waiting), buffered output is only
+ * sent once the buffer grows past its limit.
+ */
+void trio::IO::end_output()
+{
+    // Buffered output can hold on to a color change until the flush, in
+    // case another one replaces it first. Unbuffered output sends the whole
+    // operation (color, cursor move and text) in one write, which doesn't
+    // count as a flush.
+    if (!buffered)
+    {
+        apply_color();
+        send(NULL, 0);
+    }
+    else if (buffer.size() >= buffer_limit)
+        flush();
+}
+
+/**
+ * Turns buffered output on or off. While buffered, text, colors and cursor
+ * moves are collected in memory and sent to the terminal all at once, which
+ * turns a whole frame of output into a single write. Buffered output is
+ * sent by flush(), when more than limit bytes are waiting, before waiting
+ * on input, before sleeping, and when the IO object goes away.
+ * @param enabled whether output should be buffered
+ * @param limit how many bytes may wait in the buffer before it is sent
+ * @return this object, for chaining outputs
+ */
+trio::IO &trio::IO::set_buffered(bool enabled, size_t limit)
+{
+    flush();
+    buffered = enabled;
+    buffer_limit = limit;
+    return *this;
+}
+
+/**
+ * Whether output is being buffered (see set_buffered)
+ * @return true if output is collected until flush()
+ */
+bool trio::IO::is_buffered() const
+{
+    return buffered;
+}
+
+/**
+ * Sends any buffered output to the sink in a single write, and has the sink
+ * push it out
+ * @return this object, for chaining outputs
+ */
+trio::IO &trio::IO::flush()
+{
+    TRIO_STAT(counters.flushes++);
+    apply_color();
+    send(NULL, 0);
+    return *this;
+}
+
+/**
+ * Starts recording everything printed from here on, as well as printing
+ * it. Output already buffered is sent (and not recorded) first. On the
+ * Windows console only text is recorded, since colors and cursor moves are
+ * API calls there.
+ * @param path the file to record to, which is replaced if it exists
+ * @param capacity how many bytes of the recording can wait to be written
+ * before printing waits for the file
+ * @return false if the file couldn't be opened
+ */
+bool trio::IO::record(const string &path, size_t capacity)
+{
+    stop_recording();
+    flush();
+    check_size();
+    std::shared_ptr<Recorder> started = std::make_shared<Recorder>(path, sink, term_rows, term_cols, capacity);
+    if (!started->good())
+        return false;
+    recorder = started;
+    sink = recorder.get();
+    return true;
+}
+
+/**
+ * Stops recording, sending what was buffered first so it is recorded too.
+ * The recording's file is finished and closed.
+ * @return this object, for chaining
+ */
+trio::IO &trio::IO::stop_recording()
+{
+    if (!recorder)
+        return *this;
+    flush();
+    sink = recorder->target();
+    recorder.reset();
+    return *this;
+}
+
+/**
+ * Prints a span of text found while scanning a string for color codes
+ * @param text the characters to print
+ * @param size how many characters to print
+ */
+void trio::IO::MarkupPrinter::text(const char *text, size_t size)
+{
+    io.put_text(text, size);
+}
+
+/**
+ * Changes color when scanning a string finds a color code
+ * @param fg color code for the foreground
+ * @param bg color code for the background
+ */
+void trio::IO::MarkupPrinter::color(unsigned short fg, unsigned short bg)
+{
+    TRIO_STAT(io.counters.markup_segments++);
+    io.set_color(Color(fg, bg));
+}
+
+/* .d88888b                              oo          dP    8888ba.88ba             dP   dP                      dP          
+ * 88.    "'                                         88    88  `8b  `8b            88   88                      88          
+ * `Y88888b.  88d888b. .d8888b. .d8888b. dP .d8888b. 88    88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ *       `8b  88'  `88 88ooood8 88'  `"" 88 88'  `88 88    88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * d8'   .8P  88.  .88 88.  ... 88.  ... 88 88.  .88 88    88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ *  Y88888P   88Y888P' `88888P' `88888P' dP `88888P8 dP    dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * oooooooooo~88~ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ *            dP                                                                                                            
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Moves the terminal's cursor to a row/column specified by
+ * a Point object.
+ * @param point the Point containing the row/column to move to
+ * @return this object, for chaining outputs.
+ */
+trio::IO &trio::IO::operator<<(const Point &point)
+{
+    // A Point off of the terminal moves nothing, and the text after it is
+    // culled (see put_visible) until it comes back on
+    check_size();
+    positioned = culling && term_rows != 0 && term_cols != 0;
+    view_row = point.row;
+    view_col = point.col;
+    const bool visible = !positioned || (point.row < term_rows && point.col < term_cols);
+#if defined(WINDOWS)
+    if (!windows_setup)
+    {
+        setupWindows();
+    }
+    if (console)
+    {
+        // The console doesn't track text, so only an off-screen Point is
+        // culled
+        positioned = !visible;
+        if (!visible)
+            return *this;
+        // if using Windows, use windows.h
+        // We must have a reference to the active terminal for Windows
+        // Coordinates are (x, y). Columns are x, rows are y, so r/c becomes c/r
+        if (cursor_known && cursor_row == point.row && cursor_col == point.col)
+            return *this;
+        COORD cor = {(short)point.col, (short)point.row};
+        flush();
+        SetConsoleCursorPosition(stdout_terminal, cor);
+        TRIO_STAT(counters.cursor_moves++);
+        cursor_row = point.row;
+        cursor_col = point.col;
+        cursor_known = true;
+        return *this;
+    }
+#endif
+    // Anything else gets an ANSI escape
+    if (!visible)
+        return *this;
+    move_cursor(point.row, point.col);
+    end_output();
+    return *this;
+}
+
+namespace trio
+{
+    namespace detail
+    {
+        /** Writes a number's digits to out, returning one past the last */
+        inline char *put_number(char *out, unsigned int number)
+        {
+            char digits[10];
+            int count = 0;
+            do
+            {
+                digits[count++] = char('0' + number % 10);
+                number /= 10;
+            } while (number > 0);
+            while (count > 0)
+                *out++ = digits[--count];
+            return out;
+        }
+
+        /** Writes "ESC [ n letter", leaving out n when it is 1 */
+        inline char *put_csi(char *out, unsigned int n, char letter)
+        {
+            *out++ = '\033';
+            *out++ = '[';
+            if (n != 1)
+                out = put_number(out, n);
+            *out++ = letter;
+            return out;
+        }
+    } // namespace detail
+} // namespace trio
+
+/**
+ * Writes the SGR (select graphic rendition) parameters that set a color,
+ * like "31" or "48;5;17", with no separator before or after. The TrIO color
+ * codes come from a table of their ready-made digits.
+ * @param out where to write the parameters
+ * @param code a color code the terminal can show (see fit_color)
+ * @param background whether to set the background instead of the foreground
+ * @return one past the last character written
+ */
+char *trio::detail::put_sgr(char *out, unsigned int code, bool background)
+{
+    // These are the ANSI code equivalents to TrIO color codes
+    // TrIO color codes are
+    // 0: Default, 1: Black, 2: Red, 3: Yellow, 4: Green, 5: Blue, 6: Cyan,
+    // 7: Magenta, 8: White
+    static const char fg_digits[][2] = {{'3', '9'}, {'3', '0'}, {'3', '1'}, {'3', '3'}, {'3', '2'}, {'3', '4'}, {'3', '6'}, {'3', '5'}, {'3', '7'}};
+    static const char bg_digits[][2] = {{'4', '9'}, {'4', '0'}, {'4', '1'}, {'4', '3'}, {'4', '2'}, {'4', '4'}, {'4', '6'}, {'4', '5'}, {'4', '7'}};
+    if (code <= WHITE)
+    {
+        const char *digits = background ? bg_digits[code] : fg_digits[code];
+        *out++ = digits[0];
+        *out++ = digits[1];
+        return out;
+    }
+    *out++ = background ? '4' : '3';
+    *out++ = '8';
+    *out++ = ';';
+    if (code >= rgb_code)
+    {
+        *out++ = '2';
+        *out++ = ';';
+        out = put_number(out, (code >> 16) & 0xFF);
+        *out++ = ';';
+        out = put_number(out, (code >> 8) & 0xFF);
+        *out++ = ';';
+        return put_number(out, code & 0xFF);
+    }
+    *out++ = '5';
+    *out++ = ';';
+    return put_number(out, code & 0xFF);
+}
+
+/**
+ * Moves the cursor using the shortest escape sequence available. If we know
+ * where the cursor is, nothing, a carriage return/newline, relative moves
+ * (up/down/forward/back) and a column-only move are all considered, and the
+ * absolute move is only used when nothing else is shorter. Moves up and
+ * down stop at the edges of a scroll region, so moving into or out of one
+ * is always absolute. All of the sequences are built on the stack.
+ * @param row the row to move to (starting at 0)
+ * @param col the column to move to (starting at 0)
+ */
+void trio::IO::move_cursor(unsigned short row, unsigned short col)
+{
+    // Absolute position: ESC [ row ; col f (ANSI rows and columns start at 1)
+    char best[32];
+    char *best_end = best;
+    *best_end++ = '\033';
+    *best_end++ = '[';
+    if (row != 0 || col != 0)
+    {
+        best_end = detail::put_number(best_end, row + 1);
+        if (col != 0)
+        {
+            *best_end++ = ';';
+            best_end = detail::put_number(best_end, col + 1);
+        }
+    }
+    *best_end++ = 'f';
+
+    // Which side of the scroll region each row is on (0 for inside of it)
+    const int from_side = !scroll_set ? 0 : cursor_row < scroll_top ? -1 : cursor_row > scroll_bottom ? 1 : 0;
+    const int to_side = !scroll_set ? 0 : row < scroll_top ? -1 : row > scroll_bottom ? 1 : 0;
+    if (cursor_known && row == cursor_row && col == cursor_col)
+        return;
+    if (cursor_known && from_side == to_side)
+    {
+        char option[32];
+        char *end = option;
+        // First get to the right row...
+        if (row == cursor_row + 1 && col == 0 && !(scroll_set && cursor_row == scroll_bottom))
+        {
+            // Carriage return + newline lands at the start of the next row
+            *end++ = '\r';
+            *end++ = '\n';
+        }
+        else
+        {
+            if (row < cursor_row)
+                end = detail::put_csi(end, cursor_row - row, 'A');
+            else if (row > cursor_row)
+                end = detail::put_csi(end, row - cursor_row, 'B');
+            // ...then the right column, using whichever way is shortest
+            if (col != cursor_col)
+            {
+                char column[16];
+                char *column_end = detail::put_csi(column, col + 1, 'G');
+                char relative[16];
+                char *relative_end = col > cursor_col
+                                         ? detail::put_csi(relative, col - cursor_col, 'C')
+                                         : detail::put_csi(relative, cursor_col - col, 'D');
+                if (relative_end - relative < column_end - column)
+                {
+                    column_end = std::copy(relative, relative_end, column);
+                }
+                if (col == 0)
+                {
+                    column[0] = '\r';
+                    column_end = column + 1;
+                }
+                end = std::copy(column, column_end, end);
+            }
+        }
+        if (end - option < best_end - best)
+            best_end = std::copy(option, end, best);
+    }
+    put(best, best_end - best);
+    TRIO_STAT(counters.cursor_moves++);
+    cursor_row = row;
+    cursor_col = col;
+    cursor_known = true;
+}
+
+/**
+ * Changes the color of the terminal to the foreground and
+ * background specified by the Color object.
+ * @param color a Color object containing a foreground and background code
+ * (codes are specified in trio.hpp near the top of the file)
+ * @return this object, for chaining outputs.
+ */
+trio::IO &trio::IO::operator<<(const Color &color)
+{
+    set_color(color);
+    end_output();
+    return *this;
+}
+
+/**
+ * Tells the IO object how many colors the terminal can show. It starts out
+ * guessing from the COLORTERM and TERM environment variables. Colors the
+ * terminal can't show are sent as the closest one it can. The Windows
+ * console can only show the 8 TrIO colors.
+ * @param depth how many colors the terminal can show
+ * @return this object, for chaining outputs.
+ */
+trio::IO &trio::IO::set_color_depth(ColorDepth depth)
+{
+    if (!console)
+        this->depth = depth;
+    return *this;
+}
+
+/**
+ * How many colors the IO object thinks the terminal can show
+ * @return the color depth
+ */
+trio::ColorDepth trio::IO::color_depth() const
+{
+    return depth;
+}
+
+/**
+ * Sets the terminal color using a color object. The change is only
+ * remembered here; it is sent by apply_color() right before it matters, so
+ * a change that gets replaced before any text is printed (like the reset
+ * after one color segment followed by the next segment's color) costs
+ * nothing.
+ * @param c the color configuration to use on the terminal
+ */
+void trio::IO::set_color(Color c)
+{
+    if (color_pending)
+        counters.colors_skipped++;
+    color_wanted = c;
+    color_pending = true;
+}
+
+/**
+ * Sends the wanted color to the terminal, unless the terminal already has
+ * it. Only the parts of the color that changed are sent.
+ */
+void trio::IO::apply_color()
+{
+    if (!color_pending)
+        return;
+    color_pending = false;
+    // Compare what the terminal would really show, since colors it can't
+    // show may come out the same
+    const Color c(detail::fit_color(color_wanted.fg, depth), detail::fit_color(color_wanted.bg, depth));
+    if (color_known && c == color_applied)
+    {
+        counters.colors_skipped++;
+        return;
+    }
+    TRIO_STAT(counters.colors_sent++);
+
+#if defined(WINDOWS)
+    // TrIO color codes are
+    // 0: Default, 1: Black, 2: Red, 3: Yellow, 4: Green, 5: Blue, 6: Cyan,
+    // 7: Magenta, 8: White
+    // These arrays map Trio color codes to Windows color values
+    // For instance, 2 is Trio red, and at index 2 in the array
+    // we have 4, which is Window's code for red
+    static const unsigned short _fg[] = {7, 0, 4, 6, 2, 1, 3, 5, 7};
+    // Windows does it's codes kind of weird. The background color is defined by
+    // 16 * the foreground's code. (red=4, bg for red is 64)
+    // Then to actually set the color in windows, we will add the foreground and
+    // background color.
+    static const unsigned short _bg[] = {0, 0, 64, 96, 32, 16, 48, 80, 112};
+
+    // We always need to make sure the Windows terminal is configured
+    // before we perform any kind of operations on it
+    if (!windows_setup)
+        setupWindows();
+    if (console)
+    {
+        // Setting the color by adding the foreground and background colors
+        // Modifies our stdout terminal. Everything printed in the old color
+        // has to reach the console first.
+        color_applied = c;
+        color_known = true;
+        flush();
+        SetConsoleTextAttribute(stdout_terminal, _fg[c.fg] + _bg[c.bg]);
+        return;
+    }
+#endif
+    // Print a sequence of ansi characters to color the terminal, skipping
+    // the foreground or background if it is already correct. The longest
+    // sequence sets two 24-bit colors.
+    char sgr[48];
+    char *end = sgr;
+    *end++ = '\033';
+    *end++ = '[';
+    const bool send_fg = !color_known || c.fg != color_applied.fg;
+    const bool send_bg = !color_known || c.bg != color_applied.bg;
+    if (send_fg)
+        end = detail::put_sgr(end, c.fg, false);
+    if (send_fg && send_bg)
+        *end++ = ';';
+    if (send_bg)
+        end = detail::put_sgr(end, c.bg, true);
+    *end++ = 'm';
+    put(sgr, end - sgr);
+    color_applied = c;
+    color_known = true;
+}
+
+/**
+ * How many color changes were never sent to the terminal because they
+ * would not have changed anything (or were replaced before any text used
+ * them)
+ * @return the number of skipped color changes
+ */
+size_t trio::IO::colors_skipped() const
+{
+    return counters.colors_skipped;
+}
+
+/**
+ * Gets what this IO object has written and read since it was made or its
+ * statistics were last reset. With TRIO_NO_STATS defined, everything but
+ * colors_skipped stays 0.
+ * @return a copy of the statistics
+ */
+trio::IOStats trio::IO::stats() const
+{
+    IOStats result = counters;
+#if !defined(TRIO_NO_STATS)
+    // Keys read in the background are counted by the reader's thread
+    if (reader)
+        result.input_bytes += reader->bytes_read() - reader_bytes_counted;
+#endif
+    return result;
+}
+
+/**
+ * Sets all of the statistics back to 0, so the cost of one part of a
+ * program (like a single screen) can be measured
+ * @return this object, for chaining
+ */
+trio::IO &trio::IO::reset_stats()
+{
+    IOStats zero = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+    counters = zero;
+    reader_bytes_counted = reader ? reader->bytes_read() : 0;
+    return *this;
+}
+
+/**
+ * Calls sleep and returns IO object which allows us
+ * to include waiting in output chains
+ * @param ms the time in miliseconds to sleep
+ * @return the IO object which this method is called from
+ */
+trio::IO &trio::IO::sleep(int ms)
+{
+    // Whatever was printed before sleeping should be seen while we wait
+    flush();
+    trio::sleep_ms(ms);
+    return *this;
+}
+
+/**
+ * Waits for a FrameClock's next tick and returns IO object, which allows
+ * output chains to run at a steady frame rate. Use clock.tick() directly
+ * instead to find out how many frames were dropped.
+ * @param clock the FrameClock to wait on
+ * @return the IO object which this method is called from
+ */
+trio::IO &trio::IO::sleep(FrameClock &clock)
+{
+    // The frame should be on the terminal while we wait for the next one
+    flush();
+    clock.tick();
+    return *this;
+}
+
+/**
+ * Calls clear_screen and returns IO object which allows us
+ * to include screen clearing in output chains
+ * @return the IO object which this method is called from
+ */
+trio::IO &trio::IO::clear()
+{
+#if defined(WINDOWS)
+    if (console)
+    {
+        flush();
+        trio::clear_screen();
+        positioned = false;
+        cursor_row = 0;
+        cursor_col = 0;
+        cursor_known = true;
+        return *this;
+    }
+#endif
+    // Send the same escapes as clear_screen(), but through this IO object
+    // so they stay in order with buffered output
+    static const char clear_codes[] = "\033[2J\033[1;1f";
+    // Clearing fills the screen with the current background color
+    apply_color();
+    put(clear_codes, sizeof(clear_codes) - 1);
+    positioned = false;
+    cursor_row = 0;
+    cursor_col = 0;
+    cursor_known = true;
+    end_output();
+    return *this;
+}
+
+/**
+ * Whether the terminal can scroll a range of its rows by itself (with the
+ * DECSTBM scroll region). This is false on the Windows console and on
+ * terminals whose TERM is unset or "dumb", or after set_scrolling(false).
+ * @return whether the scrolling methods do anything
+ */
+bool trio::IO::can_scroll() const
+{
+    return scrolling;
+}
+
+/**
+ * Whether the terminal can scroll the rows of an area by itself without
+ * touching anything outside of it. Scroll regions are whole rows, so the
+ * area has to start at the left edge and be as wide as the terminal (whose
+ * size has to be known).
+ * @param area the area that should scroll
+ * @return whether the area can be scrolled by the terminal
+ */
+bool trio::IO::can_scroll(const Rect &area)
+{
+    if (!scrolling || area.empty() || area.col != 0)
+        return false;
+    check_size();
+    return term_cols != 0 && area.cols >= term_cols && (term_rows == 0 || area.row + area.rows <= term_rows);
+}
+
+/**
+ * Allows or forbids scrolling by the terminal. Forbidding it makes code
+ * that checks can_scroll() redraw instead, for terminals that claim to
+ * support scroll regions but get them wrong.
+ * @param enabled whether the terminal may scroll regions
+ * @return this object, for chaining
+ */
+trio::IO &trio::IO::set_scrolling(bool enabled)
+{
+    if (console)
+        return *this;
+    if (!enabled && scroll_set)
+        reset_scroll_region();
+    scrolling = enabled;
+    return *this;
+}
+
+/**
+ * Limits scrolling to a range of rows (DECSTBM). Newlines at the bottom of
+ * the range, and scroll_up/scroll_down, only move the rows inside of it.
+ * The terminal moves the cursor to the top left when the region changes.
+ * @param top the first row of the region (starting at 0)
+ * @param bottom the last row of the region, which must be below top
+ * @return this object, for chaining
+ */
+trio::IO &trio::IO::set_scroll_region(unsigned short top, unsigned short bottom)
+{
+    if (!scrolling || bottom <= top)
+        return *this;
+    char codes[32];
+    char *end = codes;
+    *end++ = '\033';
+    *end++ = '[';
+    end = detail::put_number(end, top + 1);
+    *end++ = ';';
+    end = detail::put_number(end, bottom + 1);
+    *end++ = 'r';
+    put(codes, end - codes);
+    scroll_top = top;
+    scroll_bottom = bottom;
+    scroll_set = true;
+    positioned = false;
+    cursor_row = 0;
+    cursor_col = 0;
+    cursor_known = true;
+    end_output();
+    return *this;
+}
+
+/**
+ * Lets the whole terminal scroll again. The terminal moves the cursor to the
+ * top left.
+ * @return this object, for chaining
+ */
+trio::IO &trio::IO::reset_scroll_region()
+{
+    if (!scrolling)
+        return *this;
+    put("\033[r", 3);
+    scroll_set = false;
+    positioned = false;
+    cursor_row = 0;
+    cursor_col = 0;
+    cursor_known = true;
+    end_output();
+    return *this;
+}
+
+/**
+ * Scrolls the scroll region up, leaving blank rows (in the current
+ * background color) at its bottom. Inside a region this uses index (IND)
+ * from the region's bottom row, which leaves the cursor there; without one
+ * the whole terminal scrolls (SU) and the cursor stays put.
+ * @param lines how many rows to scroll by
+ * @return this object, for chaining
+ */
+trio::IO &trio::IO::scroll_up(unsigned short lines)
+{
+    if (!scrolling || lines == 0)
+        return *this;
+    // The new rows are filled with the current background color
+    apply_color();
+    if (!scroll_set)
+    {
+        char codes[16];
+        put(codes, detail::put_csi(codes, lines, 'S') - codes);
+        end_output();
+        return *this;
+    }
+    // Scrolling by more than the region's height just blanks it
+    lines = std::min<unsigned short>(lines, scroll_bottom - scroll_top + 1);
+    positioned = false;
+    move_cursor(scroll_bottom, cursor_known ? cursor_col : 0);
+    for (unsigned short i = 0; i < lines; i++)
+        put("\033D", 2);
+    end_output();
+    return *this;
+}
+
+/**
+ * Scrolls the scroll region down, leaving blank rows (in the current
+ * background color) at its top. Inside a region this uses reverse index
+ * (RI) from the region's top row, which leaves the cursor there; without
+ * one the whole terminal scrolls (SD) and the cursor stays put.
+ * @param lines how many rows to scroll by
+ * @return this object, for chaining
+ */
+trio::IO &trio::IO::scroll_down(unsigned short lines)
+{
+    if (!scrolling || lines == 0)
+        return *this;
+    apply_color();
+    if (!scroll_set)
+    {
+        char codes[16];
+        put(codes, detail::put_csi(codes, lines, 'T') - codes);
+        end_output();
+        return *this;
+    }
+    lines = std::min<unsigned short>(lines, scroll_bottom - scroll_top + 1);
+    positioned = false;
+    move_cursor(scroll_top, cursor_known ? cursor_col : 0);
+    for (unsigned short i = 0; i < lines; i++)
+        put("\033M", 2);
+    end_output();
+    return *this;
+}
+
+#if defined(WINDOWS)
+void trio::IO::setupWindows()
+{
+    // If we're using windows and it has not yet been fixed
+    if (!windows_setup)
+    {
+        // set the console mode for unicode
+        if (console)
+            _setmode(_fileno(stdout), _O_U16TEXT);
+        // We must have a reference to the input terminal for Windows' input API
+        stdin_terminal = GetStdHandle(STD_INPUT_HANDLE);
+        // We must have a reference to the output terminal for Windows' color API
+        stdout_terminal = GetStdHandle(STD_OUTPUT_HANDLE);
+        // Mark the Windows fix as complete
+        windows_setup = true;
+    }
+}
+#endif
+
+/* .d88888b                                                      8888ba.88ba             dP   dP                      dP          
+ * 88.    "'                                                     88  `8b  `8b            88   88                      88          
+ * `Y88888b. .d8888b. 88d888b. .d8888b. .d8888b. 88d888b.        88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ *       `8b 88'  `"" 88'  `88 88ooood8 88ooood8 88'  `88        88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * d8'   .8P 88.  ... 88       88.  ... 88.  ... 88    88        88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ *  Y88888P  `88888P' dP       `88888P' `88888P' dP    dP        dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * oooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Creates a Cell
+ * @param ch the unicode code point drawn in the cell
+ * @param fg color code for the foreground
+ * @param bg color code for the background
+ */
+trio::Cell::Cell(const unsigned int &ch, const unsigned int &fg, const unsigned int &bg)
+{
+    this->ch = ch;
+    this->fg = fg;
+    this->bg = bg;
+}
+
+bool trio::Cell::operator==(const Cell &other) const
+{
+    return ch == other.ch && fg == other.fg && bg == other.bg;
+}
+
+bool trio::Cell::operator!=(const Cell &other) const
+{
+    return !(*this == other);
+}
+
+/**
+ * Creates a Screen. Both grids start out blank, and the first present()
+ * will draw every Cell since we don't know what is on the terminal yet.
+ * @param rows the number of rows in the Screen
+ * @param cols the number of columns in the Screen
+ */
+trio::Screen::Screen(const unsigned short &rows, const unsigned short &cols)
+{
+    n_rows = rows;
+    n_cols = cols;
+    front.assign(size_t(rows) * cols, Cell());
+    back.assign(size_t(rows) * cols, Cell());
+    front_valid = false;
+}
+
+unsigned short trio::Screen::rows() const
+{
+    return n_rows;
+}
+
+unsigned short trio::Screen::cols() const
+{
+    return n_cols;
+}
+
+/**
+ * Gets the back grid's Cell at a row/column
+ * @param row the row of the Cell
+ * @param col the column of the Cell
+ * @return a reference to the Cell, which may be changed directly
+ */
+trio::Cell &trio::Screen::at(const unsigned short &row, const unsigned short &col)
+{
+    return back[size_t(row) * n_cols + col];
+}
+
+/**
+ * Sets the back grid's Cell at a row/column. Positions outside of the
+ * Screen are ignored.
+ * @param row the row of the Cell
+ * @param col the column of the Cell
+ * @param cell the new Cell
+ * @return this Screen, for chaining drawing calls
+ */
+trio::Screen &trio::Screen::put(const unsigned short &row, const unsigned short &col, const Cell &cell)
+{
+    if (row < n_rows && col < n_cols)
+        back[size_t(row) * n_cols + col] = cell;
+    return *this;
+}
+
+/**
+ * Writes a (UTF-8) string into the back grid starting at a row/column using
+ * a single color. Each code point takes up as many Cells as columns it
+ * takes up on the terminal (combining marks are dropped) and text past the
+ * right edge is cut off. Color codes are not interpreted.
+ * @param row the row to write on
+ * @param col the column the text starts at
+ * @param text the text to write
+ * @param color the colors the text is drawn with
+ * @return this Screen, for chaining drawing calls
+ */
+trio::Screen &trio::Screen::print(const unsigned short &row, const unsigned short &col, const string &text, const Color &color)
+{
+    if (row < n_rows)
+        detail::print_cells(&back[size_t(row) * n_cols], n_cols, col, text.data(), text.size(), color);
+    return *this;
+}
+
+/**
+ * Writes UTF-8 text into one row of Cells. Each code point takes up as many
+ * Cells as columns it takes up on the terminal (combining marks are
+ * dropped) and text past the end of the row is cut off.
+ * @param row the first Cell of the row
+ * @param cols how many Cells are in the row
+ * @param col the column the text starts at
+ * @param text the text to write
+ * @param size the length of the text in bytes
+ * @param color the colors the text is drawn with
+ * @return the column after the last Cell written
+ */
+unsigned short trio::detail::print_cells(Cell *row, unsigned short cols, unsigned short col, const char *text, size_t size, const Color &color)
+{
+    size_t pos = 0;
+    unsigned short c = col;
+    while (c < cols && pos < size)
+    {
+        const unsigned int ch = utf8_next(text, size, pos);
+        const int width = char_width(ch);
+        if (width == 0)
+            continue;
+        // A wide character that doesn't fit is cut off like the rest
+        if (c + width > cols)
+            break;
+        // Writing over half of a wide character leaves the other half blank
+        if (c > 0 && row[c].ch == 0 && char_width(row[c - 1].ch) == 2)
+            row[c - 1].ch = ' ';
+        if (c + width < cols && row[c + width].ch == 0 && char_width(row[c + width - 1].ch) == 2)
+            row[c + width].ch = ' ';
+        row[c] = Cell(ch, color.fg, color.bg);
+        if (width == 2)
+            row[c + 1] = Cell(0, color.fg, color.bg);
+        c += width;
+    }
+    return c;
+}
+
+/**
+ * Fills the entire back grid with one Cell
+ * @param cell the Cell to copy everywhere (a blank space by default)
+ * @return this Screen, for chaining drawing calls
+ */
+trio::Screen &trio::Screen::fill(const Cell &cell)
+{
+    std::fill(back.begin(), back.end(), cell);
+    return *this;
+}
+
+/**
+ * Sends every Cell that differs between the back and front grids to the IO
+ * object, then makes the front grid match the back grid.
+ * Changed cells on a row are grouped into runs so that each run only needs a
+ * single cursor move, and a color change is only sent when the color
+ * differs from the previous cell in the run.
+ * @param io the IO object to draw with
+ */
+void trio::Screen::present(IO &io)
+{
+    present(io, vector<Rect>(1, Rect(0, 0, n_rows, n_cols)));
+}
+
+/**
+ * Sends the Cells that differ between the back and front grids inside some
+ * areas, the same way present() does for the whole Screen. If the front
+ * grid isn't known (nothing was presented yet, or after invalidate()) the
+ * whole Screen is drawn anyway. The IO object buffers the frame, so it goes
+ * out in one write even if the IO object isn't buffered.
+ * @param io the IO object to draw with
+ * @param areas the parts of the Screen that may have changed
+ */
+void trio::Screen::present(IO &io, const vector<Rect> &areas)
+{
+    const bool was_buffered = io.is_buffered();
+    if (!was_buffered)
+        io.set_buffered(true);
+    string run;
+    bool colored = false;
+    const Rect whole(0, 0, n_rows, n_cols);
+    const size_t count = front_valid ? areas.size() : 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        const Rect area = front_valid ? areas[i].intersect(whole) : whole;
+        for (unsigned short r = area.row; r < area.row + area.rows; r++)
+            present_row(io, r, area.col, area.col + area.cols, run, colored);
+    }
+    front_valid = true;
+    // Leave the terminal with its default colors
+    if (colored)
+        io << Color(0, 0);
+    if (!was_buffered)
+        io.set_buffered(false);
+}
+
+/**
+ * Sends the Cells that changed between two columns of a row
+ * @param io the IO object to draw with
+ * @param row the row to draw
+ * @param first the first column to compare
+ * @param last the column after the last one to compare
+ * @param run space for building up text, left empty
+ * @param colored whether a color has been sent during this present
+ */
+void trio::Screen::present_row(IO &io, unsigned short row, unsigned short first, unsigned short last, string &run, bool &colored)
+{
+    // A cursor move costs several bytes, so small gaps of unchanged cells
+    // between two changed runs are cheaper to just draw over again
+    static const unsigned short max_gap = 4;
+    const size_t row_start = size_t(row) * n_cols;
+    unsigned short c = first;
+    while (c < last)
+    {
+        // Skip cells that are already correct on the terminal
+        if (front_valid && front[row_start + c] == back[row_start + c])
+        {
+            c++;
+            continue;
+        }
+        // Find the end of this run, swallowing small unchanged gaps
+        unsigned short end = c + 1;
+        unsigned short last_changed = c;
+        while (end < last && (!front_valid || end - last_changed <= max_gap))
+        {
+            if (!front_valid || front[row_start + end] != back[row_start + end])
+                last_changed = end;
+            end++;
+        }
+        end = last_changed + 1;
+        // Wide characters are drawn whole, so a run can't split one
+        if (c > 0 && back[row_start + c].ch == 0 && char_width(back[row_start + c - 1].ch) == 2)
+            c--;
+        if (end < n_cols && char_width(back[row_start + end - 1].ch) == 2)
+            end++;
+        // Draw the run, changing colors only where they differ
+        io << Point(row, c);
+        for (unsigned short i = c; i < end; i++)
+        {
+            const Cell &cell = back[row_start + i];
+            if (!colored || i == c || cell.fg != back[row_start + i - 1].fg || cell.bg != back[row_start + i - 1].bg)
+            {
+                if (!run.empty())
+                {
+                    io.write(run.data(), run.size());
+                    run.clear();
+                }
+                io << Color(cell.fg, cell.bg);
+                colored = true;
+            }
+            // The right half of a wide character was drawn with it
+            if (cell.ch != 0 || i == 0 || char_width(back[row_start + i - 1].ch) != 2)
+                utf8_append(run, cell.ch != 0 ? cell.ch : ' ');
+            front[row_start + i] = cell;
+        }
+        io.write(run.data(), run.size());
+        run.clear();
+        c = end;
+    }
+}
+
+/**
+ * Forgets what is on the terminal, so the next present() redraws every Cell.
+ * This is useful after the terminal has been cleared or written to by
+ * something other than this Screen.
+ */
+void trio::Screen::invalidate()
+{
+    front_valid = false;
+}
+
+/*  888888ba                                 8888ba.88ba             dP   dP                      dP          
+ *  88    `8b                                88  `8b  `8b            88   88                      88          
+ * a88aaaa8P' .d8888b. 88d888b. .d8888b.     88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ *  88        88'  `88 88'  `88 88ooood8     88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ *  88        88.  .88 88    88 88.  ...     88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ *  dP        `88888P8 dP    dP `88888P'     dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Creates a blank Pane. It isn't drawn until it is added to a Compositor.
+ * @param area where the Pane is on the terminal, and its size
+ * @param z where the Pane is in the stack of Panes (higher is on top)
+ */
+trio::Pane::Pane(const Rect &area, const int &z)
+    : bounds(area), depth(z), shown(true), cells(size_t(area.rows) * area.cols),
+      drawn(false), drawn_depth(0), drawn_shown(false), owner(NULL)
+{
+}
+
+/** Takes the Pane off of its Compositor, if it is on one */
+trio::Pane::~Pane()
+{
+    if (owner)
+        owner->remove(*this);
+}
+
+const trio::Rect &trio::Pane::area() const
+{
+    return bounds;
+}
+
+int trio::Pane::z() const
+{
+    return depth;
+}
+
+bool trio::Pane::visible() const
+{
+    return shown;
+}
+
+/**
+ * Moves the Pane. Its Cells move with it, so nothing is marked dirty; the
+ * Compositor redraws where the Pane was and where it is now.
+ * @param row the row of the new top left corner
+ * @param col the column of the new top left corner
+ * @return this Pane, for chaining calls
+ */
+trio::Pane &trio::Pane::move(const unsigned short &row, const unsigned short &col)
+{
+    bounds.row = row;
+    bounds.col = col;
+    return *this;
+}
+
+/**
+ * Changes the Pane's size. Cells that are still inside the Pane keep their
+ * contents and new Cells are blank.
+ * @param rows the new number of rows
+ * @param cols the new number of columns
+ * @return this Pane, for chaining calls
+ */
+trio::Pane &trio::Pane::resize(const unsigned short &rows, const unsigned short &cols)
+{
+    if (rows == bounds.rows && cols == bounds.cols)
+        return *this;
+    vector<Cell> resized(size_t(rows) * cols);
+    const unsigned short keep_rows = std::min(rows, bounds.rows);
+    const unsigned short keep_cols = std::min(cols, bounds.cols);
+    for (unsigned short r = 0; r < keep_rows; r++)
+        std::copy(cells.begin() + size_t(r) * bounds.cols, cells.begin() + size_t(r) * bounds.cols + keep_cols,
+                  resized.begin() + size_t(r) * cols);
+    // A wide character cut in half by the new right edge can't be drawn
+    if (keep_cols > 0 && keep_cols == cols)
+        for (unsigned short r = 0; r < keep_rows; r++)
+            if (char_width(resized[size_t(r) * cols + cols - 1].ch) == 2)
+                resized[size_t(r) * cols + cols - 1].ch = ' ';
+    cells.swap(resized);
+    bounds.rows = rows;
+    bounds.cols = cols;
+    // The whole Pane is redrawn anyway, so older damage doesn't matter
+    damage.clear();
+    return *this;
+}
+
+/**
+ * Changes where the Pane is in the stack of Panes
+ * @param z the new position (higher is on top)
+ * @return this Pane, for chaining calls
+ */
+trio::Pane &trio::Pane::set_z(const int &z)
+{
+    depth = z;
+    return *this;
+}
+
+/**
+ * Shows or hides the Pane. A hidden Pane still keeps its Cells and can be
+ * drawn on.
+ * @param visible whether the Pane should be shown
+ * @return this Pane, for chaining calls
+ */
+trio::Pane &trio::Pane::show(const bool &visible)
+{
+    shown = visible;
+    return *this;
+}
+
+/**
+ * Gets the Cell at a row/column of the Pane. The position must be inside
+ * the Pane.
+ * @param row the row of the Cell
+ * @param col the column of the Cell
+ * @return the Cell
+ */
+const trio::Cell &trio::Pane::at(const unsigned short &row, const unsigned short &col) const
+{
+    return cells[size_t(row) * bounds.cols + col];
+}
+
+/**
+ * Sets the Cell at a row/column of the Pane and marks it dirty. Positions
+ * outside of the Pane are ignored.
+ * @param row the row of the Cell
+ * @param col the column of the Cell
+ * @param cell the new Cell
+ * @return this Pane, for chaining calls
+ */
+trio::Pane &trio::Pane::put(const unsigned short &row, const unsigned short &col, const Cell &cell)
+{
+    if (row >= bounds.rows || col >= bounds.cols)
+        return *this;
+    Cell &old = cells[size_t(row) * bounds.cols + col];
+    if (old == cell)
+        return *this;
+    old = cell;
+    mark(Rect(row, col, 1, 1));
+    return *this;
+}
+
+/**
+ * Writes text into the Pane, interpreting color codes the same way printing
+ * to an IO object does. Text is cut off at the Pane's edges, and only the
+ * Cells that were written are marked dirty.
+ * @param row the row to start writing on
+ * @param col the column to start writing at (and go back to after newlines)
+ * @param text the text to write
+ * @param color the colors used for text without a color code
+ * @return this Pane, for chaining calls
+ */
+trio::Pane &trio::Pane::print(const unsigned short &row, const unsigned short &col, const string &text, const Color &color)
+{
+    PanePrinter printer = {*this, row, col, col, color, color};
+    detail::scan_markup(text.data(), text.size(), printer);
+    return *this;
+}
+
+/**
+ * Fills the whole Pane with one Cell and marks it all dirty
+ * @param cell the Cell to fill with
+ * @return this Pane, for chaining calls
+ */
+trio::Pane &trio::Pane::fill(const Cell &cell)
+{
+    std::fill(cells.begin(), cells.end(), cell);
+    mark(Rect(0, 0, bounds.rows, bounds.cols));
+    return *this;
+}
+
+/**
+ * The areas of the Pane that changed since it was last drawn, relative to
+ * its top left corner. Presenting the Compositor clears them.
+ * @return the dirty rectangles
+ */
+const std::vector<trio::Rect> &trio::Pane::dirty() const
+{
+    return damage;
+}
+
+/**
+ * Records that an area of the Pane changed. Areas already covered by a
+ * recorded one are dropped, and once there are many of them they are
+ * merged into one rectangle covering all of them.
+ * @param changed the area that changed, relative to the Pane
+ */
+void trio::Pane::mark(const Rect &changed)
+{
+    // Past this many rectangles, tracking them costs more than it saves
+    static const size_t max_rects = 32;
+    const Rect area = changed.intersect(Rect(0, 0, bounds.rows, bounds.cols));
+    if (area.empty())
+        return;
+    for (size_t i = 0; i < damage.size(); i++)
+        if (damage[i].intersect(area) == area)
+            return;
+    if (damage.size() < max_rects)
+    {
+        damage.push_back(area);
+        return;
+    }
+    Rect all = area;
+    for (size_t i = 0; i < damage.size(); i++)
+        all = all.unite(damage[i]);
+    damage.assign(1, all);
+}
+
+/**
+ * Writes a span of text into the Pane, moving down a row at each newline
+ * @param text the text to write
+ * @param size how many characters are in the text
+ */
+void trio::Pane::PanePrinter::text(const char *text, size_t size)
+{
+    const char *const end = text + size;
+    while (text < end)
+    {
+        const char *line_end = static_cast<const char *>(memchr(text, '\n', end - text));
+        if (!line_end)
+            line_end = end;
+        if (row < pane.bounds.rows && col < pane.bounds.cols && line_end > text)
+        {
+            const unsigned short first = col;
+            col = detail::print_cells(&pane.cells[size_t(row) * pane.bounds.cols], pane.bounds.cols, col,
+                                      text, line_end - text, current);
+            // Cells next to the text lose half of a wide character when it
+            // is written over, so they changed too
+            const unsigned short left = first > 0 ? first - 1 : 0;
+            pane.mark(Rect(row, left, 1, col + 1 - left));
+        }
+        if (line_end == end)
+            break;
+        row++;
+        col = start;
+        text = line_end + 1;
+    }
+}
+
+/**
+ * Changes the colors of the text that follows. Going back to the default
+ * colors means using the Pane's colors given to print().
+ * @param fg the foreground color code
+ * @param bg the background color code
+ */
+void trio::Pane::PanePrinter::color(unsigned short fg, unsigned short bg)
+{
+    current = fg == 0 && bg == 0 ? base : Color(fg, bg);
+}
+
+/*  a88888b.                                                oo   dP                         8888ba.88ba             dP   dP                      dP          
+ * d8'   `88                                                     88                         88  `8b  `8b            88   88                      88          
+ * 88        .d8888b. 88d8b.d8b. 88d888b. .d8888b. .d8888b. dP d8888P .d8888b. 88d888b.     88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ * 88        88'  `88 88'`88'`88 88'  `88 88'  `88 Y8ooooo. 88   88   88'  `88 88'  `88     88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88       88 88   88   88.  .88 88           88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ *  Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P' `88888P' dP   dP   `88888P' dP           dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * ooooooooooooooooooooooooooooo~88~ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ *                               dP                                                                                                                          
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Creates a Compositor. Nothing has been drawn on the terminal yet, so the
+ * first present() draws every Cell.
+ * @param rows the number of rows to composite
+ * @param cols the number of columns to composite
+ */
+trio::Compositor::Compositor(const unsigned short &rows, const unsigned short &cols)
+    : screen(rows, cols), full_redraw(true)
+{
+}
+
+/** Lets go of all of the Panes, which are left as they are */
+trio::Compositor::~Compositor()
+{
+    for (size_t i = 0; i < panes.size(); i++)
+        panes[i]->owner = NULL;
+}
+
+/**
+ * Adds a Pane, taking it off of any other Compositor. It is drawn at the
+ * next present().
+ * @param pane the Pane to add, which must stay alive until it is removed
+ * (destroying the Pane removes it)
+ * @return this Compositor, for chaining calls
+ */
+trio::Compositor &trio::Compositor::add(Pane &pane)
+{
+    if (pane.owner == this)
+        return *this;
+    if (pane.owner)
+        pane.owner->remove(pane);
+    pane.owner = this;
+    pane.drawn = false;
+    panes.push_back(&pane);
+    return *this;
+}
+
+/**
+ * Removes a Pane. Whatever it covered is drawn again at the next present().
+ * @param pane the Pane to remove
+ * @return this Compositor, for chaining calls
+ */
+trio::Compositor &trio::Compositor::remove(Pane &pane)
+{
+    vector<Pane *>::iterator found = std::find(panes.begin(), panes.end(), &pane);
+    if (found == panes.end())
+        return *this;
+    panes.erase(found);
+    if (pane.drawn && pane.drawn_shown)
+        damage.push_back(pane.drawn_bounds);
+    pane.owner = NULL;
+    pane.drawn = false;
+    return *this;
+}
+
+/**
+ * Draws everything that changed since the last present(). Only the dirty
+ * rectangles of the Panes, and the areas Panes were moved, resized,
+ * restacked, shown or hidden in, are put back together from the Panes, and
+ * only the Cells in those areas that really changed are sent to the
+ * terminal.
+ * @param io the IO object to draw with
+ */
+void trio::Compositor::present(IO &io)
+{
+    // Past this many areas, compositing them one by one costs more than
+    // compositing one area covering all of them
+    static const size_t max_areas = 32;
+    const Rect whole(0, 0, screen.rows(), screen.cols());
+    vector<Rect> areas;
+    areas.swap(damage);
+    for (size_t i = 0; i < panes.size(); i++)
+    {
+        Pane &pane = *panes[i];
+        const bool changed = !pane.drawn || pane.bounds != pane.drawn_bounds ||
+                             pane.depth != pane.drawn_depth || pane.shown != pane.drawn_shown;
+        if (changed)
+        {
+            if (pane.drawn && pane.drawn_shown)
+                areas.push_back(pane.drawn_bounds);
+            if (pane.shown)
+                areas.push_back(pane.bounds);
+        }
+        else if (pane.shown)
+        {
+            for (size_t d = 0; d < pane.damage.size(); d++)
+            {
+                const Rect &dirty = pane.damage[d];
+                const unsigned int row = (unsigned int)pane.bounds.row + dirty.row;
+                const unsigned int col = (unsigned int)pane.bounds.col + dirty.col;
+                if (row < whole.rows && col < whole.cols)
+                    areas.push_back(Rect(row, col, dirty.rows, dirty.cols));
+            }
+        }
+        pane.damage.clear();
+        pane.drawn = true;
+        pane.drawn_bounds = pane.bounds;
+        pane.drawn_depth = pane.depth;
+        pane.drawn_shown = pane.shown;
+    }
+    if (full_redraw)
+        areas.assign(1, whole);
+
+    // Keep the areas on the Screen, and widen each one by a column on both
+    // sides so that wide characters cut in half at their edges get fixed
+    size_t kept = 0;
+    for (size_t i = 0; i < areas.size(); i++)
+    {
+        Rect area = areas[i];
+        if (area.col > 0)
+        {
+            area.col--;
+            area.cols = std::min(area.cols + 2, 0xFFFF);
+        }
+        else
+            area.cols = std::min(area.cols + 1, 0xFFFF);
+        area = area.intersect(whole);
+        if (!area.empty())
+            areas[kept++] = area;
+    }
+    areas.resize(kept);
+    if (areas.size() > max_areas)
+    {
+        Rect all = areas[0];
+        for (size_t i = 1; i < areas.size(); i++)
+            all = all.unite(areas[i]);
+        areas.assign(1, all);
+    }
+    if (areas.empty())
+        return;
+
+    // Panes are drawn from the bottom of the stack up
+    vector<Pane *> stack;
+    for (size_t i = 0; i < panes.size(); i++)
+        if (panes[i]->shown)
+            stack.push_back(panes[i]);
+    std::stable_sort(stack.begin(), stack.end(), [](const Pane *a, const Pane *b) { return a->depth < b->depth; });
+    for (size_t i = 0; i < areas.size(); i++)
+        compose(areas[i], stack);
+    screen.present(io, areas);
+    full_redraw = false;
+}
+
+/**
+ * Forgets what is on the terminal, so the next present() redraws every
+ * Cell. This is useful after the terminal has been cleared or written to by
+ * something other than this Compositor.
+ */
+void trio::Compositor::invalidate()
+{
+    screen.invalidate();
+    full_redraw = true;
+}
+
+unsigned short trio::Compositor::rows() const
+{
+    return screen.rows();
+}
+
+unsigned short trio::Compositor::cols() const
+{
+    return screen.cols();
+}
+
+/**
+ * Rebuilds an area of the Screen's back grid: blank Cells, with the part of
+ * each Pane inside the area copied on top, bottom of the stack first.
+ * @param area the area to rebuild
+ * @param stack the visible Panes, from the bottom of the stack to the top
+ */
+void trio::Compositor::compose(const Rect &area, const vector<Pane *> &stack)
+{
+    const unsigned short right = area.col + area.cols;
+    for (unsigned short r = area.row; r < area.row + area.rows; r++)
+        for (unsigned short c = area.col; c < right; c++)
+            screen.put(r, c, Cell());
+    for (size_t i = 0; i < stack.size(); i++)
+    {
+        const Pane &pane = *stack[i];
+        const Rect part = area.intersect(pane.bounds);
+        for (unsigned short r = part.row; r < part.row + part.rows; r++)
+        {
+            const Cell *source = &pane.cells[size_t(r - pane.bounds.row) * pane.bounds.cols + (part.col - pane.bounds.col)];
+            for (unsigned short c = 0; c < part.cols; c++)
+                screen.put(r, part.col + c, source[c]);
+        }
+    }
+    // A Pane on top can cover half of a wide character in a Pane below it,
+    // and the half that is left can't be drawn on its own
+    for (unsigned short r = area.row; r < area.row + area.rows; r++)
+    {
+        for (unsigned short c = area.col; c < right; c++)
+        {
+            Cell &cell = screen.at(r, c);
+            if (cell.ch == 0 && (c == 0 || char_width(screen.at(r, c - 1).ch) != 2))
+                cell.ch = ' ';
+            else if (char_width(cell.ch) == 2 && (c + 1 >= screen.cols() || screen.at(r, c + 1).ch != 0))
+                cell.ch = ' ';
+        }
+    }
+}
+
+/* dP                          d888888P          oo dP     8888ba.88ba             dP   dP                      dP          
+ * 88                             88                88     88  `8b  `8b            88   88                      88          
+ * 88        .d8888b. .d8888b.    88    .d8888b. dP 88     88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ * 88        88'  `88 88'  `88    88    88'  `88 88 88     88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * 88        88.  .88 88.  .88    88    88.  .88 88 88     88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ * 88888888P `88888P' `8888P88    dP    `88888P8 dP dP     dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * ooooooooooooooooooooooo~.88~ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ *                     d8888P                                                                                               
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Creates an empty LogTail. Nothing is drawn until the first line is added
+ * (or redraw() is called).
+ * @param area where the LogTail is on the terminal, and its size
+ */
+trio::LogTail::LogTail(const Rect &area) : bounds(area), lines(area.rows), first(0)
+{
+}
+
+const trio::Rect &trio::LogTail::area() const
+{
+    return bounds;
+}
+
+/**
+ * Adds a line at the bottom of the LogTail, scrolling the others up and
+ * dropping the oldest. When the terminal can scroll the area by itself
+ * this sends the new line and a few escape codes, and nothing else on the
+ * terminal is touched; otherwise every line is redrawn.
+ * @param io the IO object to draw with
+ * @param line the line to add, which may have color codes
+ */
+void trio::LogTail::append(IO &io, const string &line)
+{
+    if (lines.empty())
+        return;
+    lines[first] = line;
+    first = (first + 1) % lines.size();
+    if (!io.can_scroll(bounds) || bounds.rows < 2)
+    {
+        redraw(io);
+        return;
+    }
+    // Sent in one write, like a Screen's frame
+    const bool was_buffered = io.is_buffered();
+    if (!was_buffered)
+        io.set_buffered(true);
+    const unsigned short bottom = bounds.row + bounds.rows - 1;
+    io << Color(0, 0);
+    io.set_scroll_region(bounds.row, bottom).scroll_up(1);
+    // The new row is already blank, so there's nothing to clear after it
+    draw_line(io, bottom, line, false);
+    io.reset_scroll_region();
+    if (!was_buffered)
+        io.set_buffered(false);
+}
+
+/**
+ * Draws every line of the LogTail again, blanking the rest of each row, in
+ * one write
+ * @param io the IO object to draw with
+ */
+void trio::LogTail::redraw(IO &io)
+{
+    const bool was_buffered = io.is_buffered();
+    if (!was_buffered)
+        io.set_buffered(true);
+    for (unsigned short i = 0; i < bounds.rows; i++)
+        draw_line(io, bounds.row + i, lines[(first + i) % lines.size()], true);
+    if (!was_buffered)
+        io.set_buffered(false);
+}
+
+/**
+ * Draws one line of the LogTail, cut off at its right edge
+ * @param io the IO object to draw with
+ * @param row the terminal row to draw on
+ * @param line the line, which may have color codes
+ * @param pad whether to blank the rest of the row with spaces
+ */
+void trio::LogTail::draw_line(IO &io, unsigned short row, const string &line, bool pad)
+{
+    unsigned short width;
+    io << Point(row, bounds.col) << detail::clip_markup(line, bounds.cols, width);
+    if (pad && width < bounds.cols)
+        io << Color(0, 0) << string(bounds.cols - width, ' ');
+}
+
+/**
+ * Cuts text with color codes off after some number of columns. Color codes
+ * are kept (and only written where text follows them), '&' is escaped
+ * again, and the text stops at the first newline.
+ * @param text the text to cut off
+ * @param cols how many columns of text to keep
+ * @param width set to how many columns the kept text takes up
+ * @return the kept text, with its color codes
+ */
+std::string trio::detail::clip_markup(const string &text, unsigned short cols, unsigned short &width)
+{
+    struct Clipper
+    {
+        string result;
+        unsigned short cols;
+        unsigned short width;
+        unsigned short fg;
+        unsigned short bg;
+        bool colored;
+        bool done;
+        void text(const char *text, size_t size)
+        {
+            size_t pos = 0;
+            while (!done && pos < size)
+            {
+                const size_t start = pos;
+                const unsigned int ch = utf8_next(text, size, pos);
+                const int ch_width = ch == '\n' ? 0 : char_width(ch);
+                if (ch == '\n' || width + ch_width > cols)
+                {
+                    done = true;
+                    return;
+                }
+                // Start of a colored segment, right before its text
+                if (colored)
+                {
+                    result += '&';
+                    result += char('0' + fg);
+                    result += char('0' + bg);
+                    colored = false;
+                }
+                result.append(text + start, pos - start);
+                if (ch == '&')
+                    result += '&';
+                width += ch_width;
+            }
+        }
+        void color(unsigned short new_fg, unsigned short new_bg)
+        {
+            fg = new_fg;
+            bg = new_bg;
+            colored = fg != 0 || bg != 0;
+        }
+    } clipper = {string(), cols, 0, 0, 0, false, false};
+    clipper.result.reserve(text.size());
+    scan_markup(text.data(), text.size(), clipper);
+    width = clipper.width;
+    return clipper.result;
+}
+
+/* dP     dP oo            dP                     dP d888888P                              oo                   dP     8888ba.88ba             dP   dP                      dP          
+ * 88     88               88                     88    88                                                      88     88  `8b  `8b            88   88                      88          
+ * 88    .8P dP 88d888b. d8888P dP    dP .d8888b. 88    88    .d8888b. 88d888b. 88d8b.d8b. dP 88d888b. .d8888b. 88     88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ * 88    d8' 88 88'  `88   88   88    88 88'  `88 88    88    88ooood8 88'  `88 88'`88'`88 88 88'  `88 88'  `88 88     88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * 88  .d8P  88 88         88   88.  .88 88.  .88 88    88    88.  ... 88       88  88  88 88 88    88 88.  .88 88     88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ * 888888'   dP dP         dP   `88888P' `88888P8 dP    dP    `88888P' dP       dP  dP  dP dP dP    dP `88888P8 dP     dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
+/**
+ * Creates a blank VirtualTerminal, with the cursor at the top left and the
+ * default colors
+ * @param rows how many rows it has
+ * @param cols how many columns it has
+ */
+trio::VirtualTerminal::VirtualTerminal(const unsigned short &rows, const unsigned short &cols)
+    : n_rows(rows > 0 ? rows : 1), n_cols(cols > 0 ? cols : 1)
+{
+    reset();
+}
+
+/**
+ * Blanks the screen and puts everything (cursor, colors, scroll region and
+ * the parser) back the way it was when the VirtualTerminal was new
+ */
+void trio::VirtualTerminal::reset()
+{
+    cells.assign((size_t)n_rows * n_cols, Cell());
+    cursor_row = 0;
+    cursor_col = 0;
+    wrap_next = false;
+    scroll_top = 0;
+    scroll_bottom = n_rows - 1;
+    fg = 0;
+    bg = 0;
+    unknown_count = 0;
+    state = detail::TERMINAL_TEXT;
+    csi_ignored = false;
+    param_count = 0;
+    partial_size = 0;
+}
+
+/**
+ * Reads output the way a terminal would. Text goes where the cursor is,
+ * wrapping at the right edge and scrolling at the bottom, and escape
+ * sequences are carried out. Sequences and UTF-8 characters may be split
+ * between writes.
+ * @param text the output to read
+ * @param size how many bytes there are
+ */
+void trio::VirtualTerminal::write(const char *text, size_t size)
+{
+    const char *pos = text;
+    const char *const end = text + size;
+    // Finish a character cut off by the last write
+    if (partial_size > 0)
+    {
+        const unsigned char lead = (unsigned char)partial[0];
+        const size_t needed = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+        while (partial_size < needed && pos < end && ((unsigned char)*pos & 0xC0) == 0x80)
+            partial[partial_size++] = *pos++;
+        if (partial_size < needed && pos == end)
+            return;
+        for (size_t i = 0; i < partial_size;)
+            print(utf8_next(partial, partial_size, i));
+        partial_size = 0;
+    }
+    while (pos < end)
+    {
+        const unsigned char ch = (unsigned char)*pos;
+        if (state == detail::TERMINAL_TEXT)
+        {
+            if (ch >= 0x20 && ch < 0x7F)
+            {
+                // Runs of ASCII are by far the most common, so they are
+                // written straight into the row
+                Cell *row = &cells[(size_t)cursor_row * n_cols];
+                while (pos < end && (unsigned char)*pos >= 0x20 && (unsigned char)*pos < 0x7F)
+                {
+                    // Wrapping, and writing over half of a wide character,
+                    // take the slow way
+                    if (wrap_next || row[cursor_col].ch == 0 || (cursor_col + 1 < n_cols && row[cursor_col + 1].ch == 0))
+                    {
+                        print((unsigned char)*pos++);
+                        row = &cells[(size_t)cursor_row * n_cols];
+                        continue;
+                    }
+                    Cell &cell = row[cursor_col];
+                    cell.ch = (unsigned char)*pos++;
+                    cell.fg = fg;
+                    cell.bg = bg;
+                    if (cursor_col + 1 < n_cols)
+                        cursor_col++;
+                    else
+                        wrap_next = true;
+                }
+            }
+            else if (ch == 0x1B)
+            {
+                state = detail::TERMINAL_ESCAPE;
+                pos++;
+            }
+            else if (ch < 0x80)
+            {
+                control(ch);
+                pos++;
+            }
+            else
+            {
+                // A lead byte followed only by too few continuation bytes is
+                // finished by the next write
+                const size_t needed = ch >= 0xF0 ? 4 : ch >= 0xE0 ? 3 : 2;
+                bool cut_off = ch >= 0xC2 && ch <= 0xF4 && (size_t)(end - pos) < needed;
+                for (const char *next = pos + 1; cut_off && next < end; next++)
+                    cut_off = ((unsigned char)*next & 0xC0) == 0x80;
+                if (cut_off)
+                {
+                    partial_size = (unsigned char)(end - pos);
+                    memcpy(partial, pos, partial_size);
+                    return;
+                }
+                size_t next = pos - text;
+                print(utf8_next(text, size, next));
+                pos = text + next;
+            }
+            continue;
+        }
+        pos++;
+        if (state == detail::TERMINAL_ESCAPE)
+        {
+            state = detail::TERMINAL_TEXT;
+            switch (ch)
+            {
+            case '[':
+                state = detail::TERMINAL_CSI;
+                csi_ignored = false;
+                param_count = 0;
+                break;
+            case ']':
+            case 'P':
+            case 'X':
+            case '^':
+            case '_':
+                // Titles, device control and the like: nothing that shows
+                state = detail::TERMINAL_STRING;
+                break;
+            case 'D':
+                // IND
+                line_feed();
+                break;
+            case 'E':
+                // NEL
+                cursor_col = 0;
+                line_feed();
+                break;
+            case 'M':
+                // RI: up a row, scrolling down at the top of the region
+                wrap_next = false;
+                if (cursor_row == scroll_top)
+                    scroll(scroll_top, scroll_bottom, -1);
+                else if (cursor_row > 0)
+                    cursor_row--;
+                break;
+            case 'c':
+                reset();
+                break;
+            default:
+                unknown_count++;
+                break;
+            }
+        }
+        else if (state == detail::TERMINAL_CSI)
+        {
+            if (ch >= '0' && ch <= '9')
+            {
+                if (param_count == 0)
+                {
+                    param_count = 1;
+                    params[0] = 0;
+                }
+                unsigned int &param = params[param_count - 1];
+                if (param < 100000)
+                    param = param * 10 + (ch - '0');
+            }
+            else if (ch == ';' || ch == ':')
+            {
+                if (param_count == 0)
+                {
+                    param_count = 1;
+                    params[0] = 0;
+                }
+                if (param_count < sizeof(params) / sizeof(params[0]))
+                    params[param_count++] = 0;
+            }
+            else if (ch >= 0x20 && ch <= 0x3F)
+            {
+                // Private sequences (ESC [ ?) and ones with intermediate
+                // bytes set modes that don't change what is shown
+                csi_ignored = true;
+            }
+            else if (ch >= 0x40 && ch <= 0x7E)
+            {
+                state = detail::TERMINAL_TEXT;
+                if (!csi_ignored)
+                    run_csi((char)ch);
+            }
+            else if (ch == 0x1B)
+                state = detail::TERMINAL_ESCAPE;
+            else if (ch == 0x18 || ch == 0x1A)
+                state = detail::TERMINAL_TEXT;
+            else
+                control(ch);
+        }
+        else if (state == detail::TERMINAL_STRING)
+        {
+            // Strings end with BEL or ST (ESC \)
+            if (ch == 0x07)
+                state = detail::TERMINAL_TEXT;
+            else if (ch == 0x1B)
+                state = detail::TERMINAL_STRING_ESCAPE;
+        }
+        else
+            state = ch == '\\' ? detail::TERMINAL_TEXT : detail::TERMINAL_STRING;
+    }
+}
+
+/**
+ * Tells IO objects how big the VirtualTerminal is, so they cull and track
+ * the cursor like they would on a real terminal
+ * @param rows set to the number of rows
+ * @param cols set to the number of columns
+ * @return true
+ */
+bool trio::VirtualTerminal::size(unsigned short &rows, unsigned short &cols)
+{
+    rows = n_rows;
+    cols = n_cols;
+    return true;
+}
+
+/**
+ * How many rows the VirtualTerminal has
+ * @return the number of rows
+ */
+unsigned short trio::VirtualTerminal::rows() const
+{
+    return n_rows;
+}
+
+/**
+ * How many columns the VirtualTerminal has
+ * @return the number of columns
+ */
+unsigned short trio::VirtualTerminal::cols() const
+{
+    return n_cols;
+}
+
+/**
+ * Gets the Cell at a row/column. The right half of a wide character holds
+ * 0, like on a Screen.
+ * @param row the row of the Cell
+ * @param col the column of the Cell
+ * @return the Cell
+ */
+const trio::Cell &trio::VirtualTerminal::at(const unsigned short &row, const unsigned short &col) const
+{
+    return cells[(size_t)row * n_cols + col];
+}
+
+/**
+ * Gets the text on a row, as UTF-8, without its colors. Blanks at the end
+ * of the row are left out.
+ * @param row the row to get
+ * @return the row's text
+ */
+trio::string trio::VirtualTerminal::row_text(const unsigned short &row) const
+{
+    const Cell *cell = &cells[(size_t)row * n_cols];
+    unsigned short used = n_cols;
+    while (used > 0 && cell[used - 1].ch == ' ')
+        used--;
+    string text;
+    for (unsigned short col = 0; col < used; col++)
+    {
+        if (cell[col].ch != 0)
+            detail::append_utf8(text, cell[col].ch);
+    }
+    return text;
+}
+
+/**
+ * Gets the text on every row (see row_text), with a newline between rows
+ * @return the screen's text
+ */
+trio::string trio::VirtualTerminal::text() const
+{
+    string text;
+    for (unsigned short row = 0; row < n_rows; row++)
+    {
+        if (row > 0)
+            text += '\n';
+        text += row_text(row);
+    }
+    return text;
+}
+
+/**
+ * Where the cursor is. After printing in the last column it stays there
+ * until the next character wraps.
+ * @return the cursor's row/column
+ */
+trio::Point trio::VirtualTerminal::cursor() const
+{
+    return Point(cursor_row, cursor_col);
+}
+
+/**
+ * The color text printed now would get, as TrIO color codes (see palette
+ * and rgb for the codes of other colors)
+ * @return the current color
+ */
+trio::Color trio::VirtualTerminal::color() const
+{
+    Color color(0, 0);
+    color.fg = fg;
+    color.bg = bg;
+    return color;
+}
+
+/**
+ * How many escape sequences weren't understood. They are skipped, so a
+ * count above 0 means the screen may not be what a real terminal shows.
+ * @return the number of sequences skipped
+ */
+size_t trio::VirtualTerminal::unknown() const
+{
+    return unknown_count;
+}
+
+/**
+ * Whether two VirtualTerminals are the same size and show exactly the
+ * same Cells. The cursor and colors aren't compared.
+ * @param other the VirtualTerminal to compare to
+ * @return true if they look the same
+ */
+bool trio::VirtualTerminal::operator==(const VirtualTerminal &other) const
+{
+    return n_rows == other.n_rows && n_cols == other.n_cols && cells == other.cells;
+}
+
+/**
+ * Whether two VirtualTerminals look different (see operator==)
+ * @param other the VirtualTerminal to compare to
+ * @return true if they don't look the same
+ */
+bool trio::VirtualTerminal::operator!=(const VirtualTerminal &other) const
+{
+    return !(*this == other);
+}
+
+/**
+ * Handles a control character: newlines (which also return to the first
+ * column), carriage returns, backspaces and tabs. The rest don't show.
+ * @param ch the control character
+ */
+void trio::VirtualTerminal::control(unsigned char ch)
+{
+    switch (ch)
+    {
+    case '\n':
+    case '\v':
+    case '\f':
+        cursor_col = 0;
+        line_feed();
+        break;
+    case '\r':
+        cursor_col = 0;
+        wrap_next = false;
+        break;
+    case '\b':
+        if (cursor_col > 0 && !wrap_next)
+            cursor_col--;
+        wrap_next = false;
+        break;
+    case '\t':
+        cursor_col = cursor_col / 8 * 8 + 8 < n_cols ? cursor_col / 8 * 8 + 8 : n_cols - 1;
+        wrap_next = false;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Prints a character at the cursor in the current color, wrapping first if
+ * the last character filled the row. Wide characters take two Cells (and
+ * wrap early if only one is left), and characters that take no columns
+ * (like combining marks) are left out, since a Cell holds one code point.
+ * @param ch the character's code point
+ */
+void trio::VirtualTerminal::print(unsigned int ch)
+{
+    const int width = char_width(ch);
+    if (width == 0)
+        return;
+    if (wrap_next || (width == 2 && cursor_col + 1 >= n_cols))
+    {
+        if (width == 2 && n_cols < 2)
+            return;
+        cursor_col = 0;
+        line_feed();
+    }
+    unpair(cursor_row, cursor_col);
+    Cell *cell = &cells[(size_t)cursor_row * n_cols + cursor_col];
+    cell[0] = Cell(ch, fg, bg);
+    if (width == 2)
+    {
+        unpair(cursor_row, cursor_col + 1);
+        cell[1] = Cell(0, fg, bg);
+    }
+    if (cursor_col + width < n_cols)
+        cursor_col += width;
+    else
+    {
+        cursor_col = n_cols - 1;
+        wrap_next = true;
+    }
+}
+
+/**
+ * Moves the cursor down a row. At the bottom of the scroll region the
+ * region scrolls up instead, and at the bottom of the screen (outside of
+ * the region) the cursor stays put.
+ */
+void trio::VirtualTerminal::line_feed()
+{
+    wrap_next = false;
+    if (cursor_row == scroll_bottom)
+        scroll(scroll_top, scroll_bottom, 1);
+    else if (cursor_row + 1 < n_rows)
+        cursor_row++;
+}
+
+/**
+ * Moves a range of rows up, dropping the rows at the top and blanking the
+ * ones uncovered at the bottom (or the other way around, moving down)
+ * @param top the first row to move
+ * @param bottom the last row to move
+ * @param lines how many rows to move up by, or down by if negative
+ */
+void trio::VirtualTerminal::scroll(unsigned short top, unsigned short bottom, int lines)
+{
+    const int height = bottom - top + 1;
+    const int count = lines < 0 ? -lines : lines;
+    const size_t first = (size_t)top * n_cols;
+    const size_t last = (size_t)(bottom + 1) * n_cols;
+    if (count >= height)
+    {
+        erase(first, last);
+        return;
+    }
+    const size_t shift = (size_t)count * n_cols;
+    if (lines > 0)
+    {
+        std::copy(cells.begin() + first + shift, cells.begin() + last, cells.begin() + first);
+        erase(last - shift, last);
+    }
+    else
+    {
+        std::copy_backward(cells.begin() + first, cells.begin() + last - shift, cells.begin() + last);
+        erase(first, first + shift);
+    }
+}
+
+/**
+ * Blanks a range of Cells (counting left to right, then top to bottom)
+ * with the current background color, like terminals do. A wide character
+ * cut in half by either end of the range is blanked too.
+ * @param first the first Cell to blank
+ * @param last the Cell after the last one to blank
+ */
+void trio::VirtualTerminal::erase(size_t first, size_t last)
+{
+    if (first >= last)
+        return;
+    unpair(first / n_cols, first % n_cols);
+    if (last < cells.size() && last % n_cols != 0)
+        unpair(last / n_cols, last % n_cols);
+    std::fill(cells.begin() + first, cells.begin() + last, Cell(' ', 0, bg));
+}
+
+/**
+ * Gets a Cell ready to be written over: if it is half of a wide character,
+ * the other half is blanked, since half of a character can't be shown
+ * @param row the row of the Cell
+ * @param col the column of the Cell
+ */
+void trio::VirtualTerminal::unpair(unsigned short row, unsigned short col)
+{
+    Cell *cell = &cells[(size_t)row * n_cols];
+    if (cell[col].ch == 0 && col > 0)
+        cell[col - 1].ch = ' ';
+    if (col + 1 < n_cols && cell[col + 1].ch == 0)
+        cell[col + 1].ch = ' ';
+}
+
+/**
+ * Carries out a control sequence (ESC [ params final): cursor moves,
+ * erasing, scrolling, the scroll region and colors
+ * @param final the letter that ended the sequence
  */
-std::string trio::fuse(string left, string right, bool pad)
+void trio::VirtualTerminal::run_csi(char final)
 {
-    string result = "";
-    // split the strings, create vectors
-    vector<string> lv = split(left, '\n');
-    vector<string> rv = split(right, '\n');
-    // correct the number of lines in the strings so they match
-    if (lv.size() > rv.size())
+    // Missing parameters (and 0, for the counts) mean 1
+    const unsigned int first = param_count > 0 && params[0] > 0 ? params[0] : 1;
+    const unsigned int second = param_count > 1 && params[1] > 0 ? params[1] : 1;
+    const unsigned int mode = param_count > 0 ? params[0] : 0;
+    const size_t here = (size_t)cursor_row * n_cols + cursor_col;
+    const size_t row_start = (size_t)cursor_row * n_cols;
+    switch (final)
+    {
+    case 'H':
+    case 'f':
+        // CUP
+        cursor_row = first < n_rows ? first - 1 : n_rows - 1;
+        cursor_col = second < n_cols ? second - 1 : n_cols - 1;
+        break;
+    case 'A':
     {
-        int diff = lv.size() - rv.size();
-        for (int i = 0; i < diff; i++)
+        // CUU stops at the top of the scroll region, if it starts below it
+        const unsigned int limit = cursor_row >= scroll_top ? scroll_top : 0;
+        cursor_row = cursor_row >= limit + first ? cursor_row - first : limit;
+        break;
+    }
+    case 'B':
+    case 'e':
+    {
+        // CUD stops at the bottom of the scroll region, if it starts above it
+        const unsigned int limit = cursor_row <= scroll_bottom ? scroll_bottom : n_rows - 1;
+        cursor_row = cursor_row + first <= limit ? cursor_row + first : limit;
+        break;
+    }
+    case 'C':
+    case 'a':
+        cursor_col = cursor_col + first < n_cols ? cursor_col + first : n_cols - 1;
+        break;
+    case 'D':
+        cursor_col = cursor_col > first ? cursor_col - first : 0;
+        break;
+    case 'E':
+        cursor_row = cursor_row + first < n_rows ? cursor_row + first : n_rows - 1;
+        cursor_col = 0;
+        break;
+    case 'F':
+        cursor_row = cursor_row > first ? cursor_row - first : 0;
+        cursor_col = 0;
+        break;
+    case 'G':
+    case '`':
+        // CHA
+        cursor_col = first < n_cols ? first - 1 : n_cols - 1;
+        break;
+    case 'd':
+        // VPA
+        cursor_row = first < n_rows ? first - 1 : n_rows - 1;
+        break;
+    case 'J':
+        // ED: 0 is to the end of the screen, 1 to the start, 2 and 3 all of it
+        if (mode == 0)
+            erase(here, cells.size());
+        else if (mode == 1)
+            erase(0, here + 1);
+        else
+            erase(0, cells.size());
+        break;
+    case 'K':
+        // EL: the same, for the cursor's row
+        if (mode == 0)
+            erase(here, row_start + n_cols);
+        else if (mode == 1)
+            erase(row_start, here + 1);
+        else
+            erase(row_start, row_start + n_cols);
+        break;
+    case 'X':
+        // ECH
+        erase(here, here + std::min<size_t>(first, n_cols - cursor_col));
+        break;
+    case 'S':
+        scroll(scroll_top, scroll_bottom, (int)std::min<unsigned int>(first, n_rows));
+        break;
+    case 'T':
+        scroll(scroll_top, scroll_bottom, -(int)std::min<unsigned int>(first, n_rows));
+        break;
+    case 'L':
+    case 'M':
+        // IL/DL move the rest of the scroll region from the cursor's row
+        if (cursor_row >= scroll_top && cursor_row <= scroll_bottom)
         {
-            rv.push_back("");
+            const int count = (int)std::min<unsigned int>(first, n_rows);
+            scroll(cursor_row, scroll_bottom, final == 'L' ? -count : count);
+            cursor_col = 0;
         }
-    }
-    else if (lv.size() < rv.size())
+        break;
+    case 'r':
     {
-
-        int diff = rv.size() - lv.size();
-        for (int i = 0; i < diff; i++)
+        // DECSTBM, which also moves the cursor home
+        const unsigned int top = first;
+        const unsigned int bottom = param_count > 1 && params[1] > 0 && params[1] <= n_rows ? params[1] : n_rows;
+        if (top < bottom)
         {
-            lv.push_back("");
+            scroll_top = top - 1;
+            scroll_bottom = bottom - 1;
+            cursor_row = 0;
+            cursor_col = 0;
         }
+        break;
     }
-    if (pad)
+    case 'm':
+        run_sgr();
+        break;
+    case 'h':
+    case 'l':
+    case 'n':
+    case 'c':
+    case 'q':
+        // Modes and reports, which don't change what is shown
+        break;
+    default:
+        unknown_count++;
+        break;
+    }
+    wrap_next = false;
+}
+
+/**
+ * Carries out a color change (SGR). The 8 basic colors become TrIO color
+ * codes, and 256 color and 24-bit colors the codes palette() and rgb()
+ * make, so Cells can be compared with what was printed. Other attributes
+ * (bold, underline and so on) are left out.
+ */
+void trio::VirtualTerminal::run_sgr()
+{
+    // The ANSI colors 0-7 (black, red, green, yellow, blue, magenta, cyan,
+    // white) as TrIO color codes
+    static const unsigned short ansi_to_trio[] = {BLACK, RED, GREEN, YELLOW, BLUE, MAGENTA, CYAN, WHITE};
+    if (param_count == 0)
+    {
+        fg = 0;
+        bg = 0;
+        return;
+    }
+    for (unsigned int i = 0; i < param_count; i++)
     {
-        // find the largest line out of any of the vectors
-        int max = 0;
-        for (int i = 0; i < lv.size(); i++)
+        const unsigned int code = params[i];
+        if (code == 0)
         {
-            if (lv[i].size() > max)
-                max = lv[i].size();
-            if (rv[i].size() > max)
-                max = rv[i].size();
+            fg = 0;
+            bg = 0;
         }
-        // for each line in both vectors, pad the line for max size
-        for (int i = 0; i < lv.size(); i++)
+        else if (code >= 30 && code <= 37)
+            fg = ansi_to_trio[code - 30];
+        else if (code == 39)
+            fg = 0;
+        else if (code >= 40 && code <= 47)
+            bg = ansi_to_trio[code - 40];
+        else if (code == 49)
+            bg = 0;
+        else if (code >= 90 && code <= 97)
+            fg = palette(code - 90 + 8);
+        else if (code >= 100 && code <= 107)
+            bg = palette(code - 100 + 8);
+        else if ((code == 38 || code == 48) && i + 1 < param_count)
         {
-            if (lv[i].size() < max)
+            unsigned int color = 0;
+            if (params[i + 1] == 5 && i + 2 < param_count)
             {
-                int diff = max - lv[i].size();
-                lv[i] += std::string(diff, ' ');
+                color = palette(params[i + 2] & 0xFF);
+                i += 2;
             }
-            if (rv[i].size() < max)
+            else if (params[i + 1] == 2 && i + 4 < param_count)
             {
-                int diff = max - rv[i].size();
-                rv[i] += std::string(diff, ' ');
+                color = rgb(params[i + 2] & 0xFF, params[i + 3] & 0xFF, params[i + 4] & 0xFF);
+                i += 4;
             }
+            else
+                break;
+            if (code == 38)
+                fg = color;
+            else
+                bg = color;
         }
     }
-    // loop through the vectors and produce the new string
-    for (int i = 0; i < lv.size(); i++)
-    {
-        result += lv[i] + rv[i] + '\n';
-    }
-    return result;
 }
 
+/* 88888888b                                         a88888b. dP                   dP           8888ba.88ba             dP   dP                      dP          
+ * 88                                               d8'   `88 88                   88           88  `8b  `8b            88   88                      88          
+ * a88aaaa    88d888b. .d8888b. 88d8b.d8b. .d8888b. 88        88 .d8888b. .d8888b. 88  .dP      88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ * 88         88'  `88 88'  `88 88'`88'`88 88ooood8 88        88 88'  `88 88'  `"" 88888"       88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * 88         88       88.  .88 88  88  88 88.  ... Y8.   .88 88 88.  .88 88.  ... 88  `8b.     88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ * dP         dP       `88888P8 dP  dP  dP `88888P'  Y88888P' dP `88888P' `88888P' dP   `YP     dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * oooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+ * Nancyj-Underlined font
+ * http://patorjk.com/software/taag/
+ */
+
 /**
- * Fuses multiple multi-line strings together for printing side-by-side.
- * @param strings an initializer list of strings to fuse, left to right
- * Initializer lists look like: {myStrVar, "Hello", "test", other_string_var}
- * @param pad bool, whether to pad each line of the string to be the same width
+ * Creates a FrameClock. The first frame's deadline is one frame from now.
+ * @param fps how many frames per second to tick, or 0 to never wait
  */
-std::string trio::fuse(std::initializer_list<string> strings, bool pad)
+trio::FrameClock::FrameClock(double fps)
 {
-    // Variable for storing the resulting string
-    string result = "";
-    // Moving the initializer_list into a vector b/c I think they're easier
-    vector<string> vstrings;
-    vstrings.insert(vstrings.end(), strings.begin(), strings.end());
-    // Loop through all strings and fuse them
-    for (int i = 0; i < vstrings.size(); i++)
-    {
-        result = fuse(result, vstrings[i], pad);
-    }
-    return result;
+    rate = 0;
+    period = clock::duration::zero();
+    recent.reserve(1024);
+    set_fps(fps);
+    reset();
 }
 
 /**
- * Fuses multiple multi-line strings together for printing side-by-side.
- * 
- * I didn't think you could create a dynamic intializer list, so I just
- * filled a vector with strings ....
- * 
- * @param strings a vector of strings ordered left to right
- * 
- * @param pad bool, whether to pad each line of the string to be the same width
+ * Changes how many frames per second the clock ticks. The next deadline is
+ * one new frame after the last one, so the change takes effect right away.
+ * @param fps how many frames per second to tick, or 0 to never wait
  */
-std::string trio::fuse(std::vector<string> strings, bool pad)
+void trio::FrameClock::set_fps(double fps)
 {
-    // Variable for storing the resulting string
-    string result = "";
-    // Moving the initializer_list into a vector b/c I think they're easier
-
-    // Loop through all strings and fuse them
-    for (int i = 0; i < strings.size(); i++)
-    {
-        result = fuse(result, strings[i], pad);
-    }
-    return result;
+    clock::duration old_period = period;
+    rate = fps > 0 ? fps : 0;
+    if (rate > 0)
+        period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / rate));
+    else
+        period = clock::duration::zero();
+    deadline += period - old_period;
 }
 
 /**
- * Split a string and store each new substring in a vector.
- * @param text the original string
- * @param delim the delimiting character to split by
- * @param include determines if the delimeter should be included in the
- * returned substrings
- * @return vector containing each substring
+ * How many frames per second the clock ticks
+ * @return the frame rate, 0 if the clock never waits
  */
-std::vector<std::string> trio::split(string text, char delim, bool include)
+double trio::FrameClock::fps() const
 {
-    // Just calls the regular expression split but delimeter does not have to be
-    // a regular expression
-    return rsplit(text, string(1, delim), include);
+    return rate;
 }
 
 /**
- * Split a string, using a regular expression as a delimeter, and store
- * each new substring in a vector.
- * Part of the rsplit() implementation came from Stack Overflow user Marcin,
- * see the following post:
- * https://stackoverflow.com/questions/16749069/c-split-string-by-regex
- * @param text the original string
- * @param delim the regular expression to match and split by
- * @param include determines if the delimeter should be included in the
- * returned substrings
- * @return vector containing each substring
+ * Ends the current frame and waits until the next frame's deadline. A frame
+ * that finishes late has missed its deadline, and the next frame starts
+ * without waiting. If whole frames went by while it ran, their deadlines
+ * are skipped (dropped) so the clock lines back up with real time; a game
+ * can use the returned count to advance its simulation the same amount.
+ * @return how many frames passed, 1 unless frames were dropped
  */
-std::vector<std::string> trio::rsplit(string text, string delim, bool include)
+unsigned int trio::FrameClock::tick()
 {
-    std::vector<std::string> elems;
-    std::regex rgx(delim);
-    // Find parts of the string which do not match the regexp and append them
-    // to the vector
-    // code -1 at the end means find everything but the rgx string (delimeter)
-    std::sregex_token_iterator iter(text.begin(), text.end(), rgx, -1);
-    std::sregex_token_iterator end;
-    while (iter != end)
-    {
-        elems.push_back(*(iter));
-        ++iter;
-    }
+    clock::time_point now = clock::now();
+    double frame_ms = std::chrono::duration<double, std::milli>(now - frame_start).count();
+    if (totals.frames == 0 || frame_ms < totals.min_ms)
+        totals.min_ms = frame_ms;
+    totals.frames++;
+    total_ms += frame_ms;
+    if (recent.size() < recent.capacity())
+        recent.push_back((float)frame_ms);
+    else
+        recent[next_recent] = (float)frame_ms;
+    next_recent = (next_recent + 1) % recent.capacity();
 
-    // If we want to include the delimeter, then we need to go re-add it to
-    // the beginning of each line.
-    if (include)
+    unsigned int passed = 1;
+    deadline += period;
+    if (period == clock::duration::zero())
     {
-        // code 0 at the end means find instances of the rgx string (delimeter)
-        std::sregex_token_iterator iter(text.begin(), text.end(), rgx, 0);
-        std::sregex_token_iterator end;
-
-        int i = 0;
-        while (iter != end)
-        {
-            // We are inserting the delimiter at the start
-            // of the NEXT string in the vector
-            string temp = elems[i + 1];
-            // assign the string the delimiter
-            elems[i + 1] = *iter;
-            // add back the original content
-            elems[i + 1] += temp;
-            // the iterator moves forward
-            ++iter;
-            // increment elems index
-            i++;
-        }
+        // No frame rate, so there is nothing to wait for or fall behind
+        deadline = now;
     }
-
-    return elems;
-}
-
-/**
- * Replaces all instances of a substring in a text with a new string.
- * @param text the main text to replace in
- * @param from the substring to replace
- * @param to the new string to replace it with
- * @return the updated main string
- */
-std::string trio::replace_all(string text, string from, string to)
-{
-    size_t start_pos = 0;
-    // While we can find the substring "from"
-    // (start position changes each time we make a replacement)
-    while ((start_pos = text.find(from, start_pos)) != string::npos)
+    else if (now > deadline)
     {
-        // Make the replacement
-        text.replace(start_pos, from.length(), to);
-        // Move past the string replacement's length, we don't need to
-        // check it
-        start_pos += to.length();
+        totals.missed++;
+        clock::duration::rep behind = (now - deadline) / period;
+        deadline += behind * period;
+        totals.dropped += (size_t)behind;
+        passed += (unsigned int)behind;
     }
-    return text;
+    else
+        std::this_thread::sleep_until(deadline);
+    frame_start = clock::now();
+    return passed;
 }
 
 /**
- * Makes the program (or rather, current thread) stop executing and wait
- * a specified length of time before continuing
- * @param ms how much time, in miliseconds (1/1000 of a second), the
- * program should sleep
+ * Timing for the frames so far. The 99th percentile is taken from the most
+ * recent 1024 frames, so it follows changes in how heavy frames are.
+ * @return the FrameStats, all zero if no frames have been timed
  */
-void trio::sleep_ms(int ms)
-{
-    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
-}
-
-void trio::clear_screen()
+trio::FrameStats trio::FrameClock::stats() const
 {
-#if defined(WINDOWS)
-    // The Windows version of this method comes almost character-for-character
-    // from the Microsoft docs. Credit Here:
-    // https://docs.microsoft.com/en-us/windows/console/clearing-the-screen
-    static HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-    COORD coordScreen = {0, 0}; // home for the cursor
-    DWORD cCharsWritten;
-    CONSOLE_SCREEN_BUFFER_INFO csbi;
-    DWORD dwConSize;
-    if (!GetConsoleScreenBufferInfo(hConsole, &csbi))
-    {
-        return;
-    }
-    dwConSize = csbi.dwSize.X * csbi.dwSize.Y;
-    if (!FillConsoleOutputCharacter(hConsole, (TCHAR)' ', dwConSize, coordScreen, &cCharsWritten))
-    {
-        return;
-    }
-    if (!GetConsoleScreenBufferInfo(hConsole, &csbi))
-    {
-        return;
-    }
-    if (!FillConsoleOutputAttribute(hConsole, csbi.wAttributes, dwConSize, coordScreen, &cCharsWritten))
-    {
-        return;
-    }
-    SetConsoleCursorPosition(hConsole, coordScreen);
-#else
-    // on *nix use ANSI escape
-    std::cout << "\033[2J" << std::flush;
-    // Return cursor to position 0,0 after clearing screen
-    std::cout << "\033[1;1f" << std::flush;
-#endif
+    FrameStats result = totals;
+    if (result.frames == 0)
+        return result;
+    result.avg_ms = total_ms / result.frames;
+    vector<float> sorted(recent);
+    size_t index = (sorted.size() * 99 + 99) / 100 - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    result.p99_ms = sorted[index];
+    return result;
 }
 
 /**
- * It is easier to consistently pass in strings instead of keeping track of
- * wide vs narrow strings. So, we will overload << to make wostreams able to
- * work with strings (by converting them inside the operation to wstring)
- * @param wout the wide ostream to be output to
- * @param text the text to be converted to a wstring
- * @return the same wostream being used (for chaining output statements)
+ * Restarts the clock: the next deadline is one frame from now, and the
+ * timing collected so far is thrown away.
  */
-std::wostream &trio::operator<<(wostream &wout, string text)
+void trio::FrameClock::reset()
 {
-    /**
-     * create a string <-> wide string converter
-     * example from stack overflow
-     * std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-     * std::string narrow = converter.to_bytes(wide_utf16_source_string);
-     * std::wstring wide = converter.from_bytes(narrow_utf8_source_string);
-     */
-    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-    std::wstring wide_text = converter.from_bytes(text);
-    wout << wide_text;
-    return wout;
+    totals.frames = 0;
+    totals.missed = 0;
+    totals.dropped = 0;
+    totals.min_ms = 0;
+    totals.avg_ms = 0;
+    totals.p99_ms = 0;
+    total_ms = 0;
+    recent.clear();
+    next_recent = 0;
+    frame_start = clock::now();
+    deadline = frame_start;
 }
 
-/*  888888ba           oo            dP      8888ba.88ba             dP   dP                      dP          
- *  88    `8b                        88      88  `8b  `8b            88   88                      88          
- * a88aaaa8P' .d8888b. dP 88d888b. d8888P    88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
- *  88        88'  `88 88 88'  `88   88      88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
- *  88        88.  .88 88 88    88   88      88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
- *  dP        `88888P' dP dP    dP   dP      dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
- * ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
+
+/* 888888ba                           dP                   d888888P dP                                        dP     8888ba.88ba             dP   dP                      dP          
+ * 88    `8b                          88                      88    88                                        88     88  `8b  `8b            88   88                      88          
+ * a88aaaa8P' .d8888b. 88d888b. .d888b88 .d8888b. 88d888b.    88    88d888b. 88d888b. .d8888b. .d8888b. .d888b88     88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ * 88   `8b.  88ooood8 88'  `88 88'  `88 88ooood8 88'  `88    88    88'  `88 88'  `88 88ooood8 88'  `88 88'  `88     88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * 88     88  88.  ... 88    88 88.  .88 88.  ... 88          88    88    88 88       88.  ... 88.  .88 88.  .88     88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ * dP     dP  `88888P' dP    dP `88888P8 `88888P' dP          dP    dP    dP dP       `88888P' `88888P8 `88888P8     dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
  * Nancyj-Underlined font
  * http://patorjk.com/software/taag/
  */
 
 /**
- * Creates a point
- * @param row the row where the point is positioned
- * @param col the column where the point is positioned
+ * Starts the printing thread. Output on io is buffered while the thread
+ * runs, so each batch of records is sent to the terminal in one write.
+ * @param io the IO object to print with
  */
-trio::Point::Point(const unsigned short &row, const unsigned short &col)
+trio::detail::RenderQueue::RenderQueue(IO &io)
+    : io(io), queued(0), printed(0), stopping(false), waiting(false)
 {
-    this->row = row;
-    this->col = col;
+    was_buffered = io.is_buffered();
+    io.set_buffered(true);
+    thread = std::thread(&RenderQueue::run, this);
 }
 
-/*  a88888b.          dP                      8888ba.88ba             dP   dP                      dP          
- * d8'   `88          88                      88  `8b  `8b            88   88                      88          
- * 88        .d8888b. 88 .d8888b. 88d888b.    88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
- * 88        88'  `88 88 88'  `88 88'  `88    88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
- * Y8.   .88 88.  .88 88 88.  .88 88          88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
- *  Y88888P' `88888P' dP `88888P' dP          dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
- * oooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
- * Nancyj-Underlined font
- * http://patorjk.com/software/taag/
- */
-
 /**
- * Creates a Color object
- * @param fg color code for the foreground
- * @param bg color code for the background
+ * Stops the printing thread once everything queued has been printed, and
+ * puts the IO object's buffering back the way it was
  */
-trio::Color::Color(const unsigned short &fg, const unsigned short &bg)
+trio::detail::RenderQueue::~RenderQueue()
 {
-    this->fg = fg;
-    this->bg = bg;
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex);
+        stopping = true;
+        wakeup.notify_one();
+    }
+    thread.join();
+    io.set_buffered(was_buffered);
 }
 
-/* ██╗ ██████╗     ███╗   ███╗███████╗████████╗██╗  ██╗ ██████╗ ██████╗ ███████╗
- * ██║██╔═══██╗    ████╗ ████║██╔════╝╚══██╔══╝██║  ██║██╔═══██╗██╔══██╗██╔════╝
- * ██║██║   ██║    ██╔████╔██║█████╗     ██║   ███████║██║   ██║██║  ██║███████╗
- * ██║██║   ██║    ██║╚██╔╝██║██╔══╝     ██║   ██╔══██║██║   ██║██║  ██║╚════██║
- * ██║╚██████╔╝    ██║ ╚═╝ ██║███████╗   ██║   ██║  ██║╚██████╔╝██████╔╝███████║
- * ╚═╝ ╚═════╝     ╚═╝     ╚═╝╚══════╝   ╚═╝   ╚═╝  ╚═╝ ╚═════╝ ╚═════╝ ╚══════╝
- * ANSI Shadow font
- * http://patorjk.com/software/taag/
+/**
+ * Queues a record for the printing thread, waking it up if it is waiting.
+ * The only lock ever taken is to wake the thread, which never holds it
+ * while printing.
+ * @param record the record to print
  */
+void trio::detail::RenderQueue::push(RenderRecord &&record)
+{
+    records.push(std::move(record));
+    queued.fetch_add(1, std::memory_order_relaxed);
+    // Pairs with the fence in run, so either the thread sees the record or
+    // we see that it is waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex);
+        wakeup.notify_one();
+    }
+}
 
 /**
- * Default constructor for the IO object.
- * By default, IO uses a wide stream on Windows and a normal stream on *nix
+ * Waits until every record queued before this call has been printed
  */
-trio::IO::IO()
+void trio::detail::RenderQueue::wait_printed()
 {
-#if defined(WINDOWS)
-    windows_setup = false;
-    wide = true;
-    wout = &wcout;
-#else
-    wide = false;
-    out = &cout;
-#endif
+    size_t target = queued.load();
+    std::unique_lock<std::mutex> lock(wait_mutex);
+    done.wait(lock, [this, target]() { return printed.load() >= target; });
 }
 
-/* dP                               dP      8888ba.88ba             dP   dP                      dP          
- * 88                               88      88  `8b  `8b            88   88                      88          
- * 88 88d888b.  88d888b. dP    dP d8888P    88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
- * 88 88'  `88  88'  `88 88    88   88      88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
- * 88 88    88  88.  .88 88.  .88   88      88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
- * dP dP    dP  88Y888P' `88888P'   dP      dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
- * oooooooooooo~88~oooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
- *              dP                                                                                           
- * Nancyj-Underlined font
- * http://patorjk.com/software/taag/
+/**
+ * Prints records in batches until the RenderThread goes away. Each batch is
+ * everything that was queued while the last one was being printed.
  */
+void trio::detail::RenderQueue::run()
+{
+    RenderRecord record;
+    while (true)
+    {
+        size_t count = 0;
+        while (records.pop(record))
+        {
+            if (record.move)
+                io << Point(record.row, record.col);
+            // Colors are put back after every record so they can't leak
+            // into the next one
+            io << record.text << Color(0, 0);
+            count++;
+        }
+        if (count > 0)
+        {
+            io.flush();
+            printed.fetch_add(count);
+            std::lock_guard<std::mutex> lock(wait_mutex);
+            done.notify_all();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        // A record that is only halfway pushed still counts as queued
+        if (stopping && printed.load() == queued.load())
+            break;
+        waiting = true;
+        // Pairs with the fence in push
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wakeup.wait_for(lock, std::chrono::milliseconds(stopping ? 1 : 100), [this]() {
+            return printed.load() != queued.load() || stopping.load();
+        });
+        waiting = false;
+    }
+}
 
 /**
- * Gets a single character from stdin.
- * Input is unbuffered, echoless, blocking. For non-blocking, use a
- * separate thread.
- * @param ch_var the variable to read a character into
- * @return this object (for chaining inputs)
+ * Starts a thread that prints queued records to an IO object
+ * @param io the IO object to print with, which must outlive the
+ * RenderThread
  */
-trio::IO &trio::IO::operator>>(unsigned char &ch_var)
+trio::RenderThread::RenderThread(IO &io) : queue(new detail::RenderQueue(io))
 {
-#if defined(WINDOWS)
-    // Setup Windows if we haven't yet.
-    if (!windows_setup)
-        setupWindows();
-
-    // Keeps track of the console mode we started with
-    DWORD mode;
-    // Get the current mode so we can restore it later
-    GetConsoleMode(stdin_terminal, &mode);
-    // Set the console mode to unbuffered and echoless
-    SetConsoleMode(stdin_terminal, 0);
-
-    //ch_var = std::cin.get();
-    DWORD cc;
-    TCHAR c = 0;
-    ReadConsole(stdin_terminal, &c, 1, &cc, NULL);
-    ch_var = (unsigned char)c;
+}
 
-    // Restore the original console mode
-    SetConsoleMode(stdin_terminal, mode);
-#else
+/**
+ * Prints everything that is still queued, then stops the thread
+ */
+trio::RenderThread::~RenderThread()
+{
+}
 
-    // borrowed from anonymous stackoverflow user at
-    // https://stackoverflow.com/questions/421860/capture-characters-from-standard-input-without-waiting-for-enter-to-be-pressed
-    char buf = 0;
-    struct termios old = {0};
-    if (tcgetattr(0, &old) < 0)
-        perror("tcsetattr()");
-    old.c_lflag &= ~ICANON;
-    old.c_lflag &= ~ECHO;
-    old.c_cc[VMIN] = 1;
-    old.c_cc[VTIME] = 0;
-    if (tcsetattr(0, TCSANOW, &old) < 0)
-        perror("tcsetattr ICANON");
-    if (read(0, &buf, 1) < 0)
-        perror("read()");
-    old.c_lflag |= ICANON;
-    old.c_lflag |= ECHO;
-    if (tcsetattr(0, TCSADRAIN, &old) < 0)
-        perror("tcsetattr ~ICANON");
-    ch_var = buf;
+/**
+ * Queues a record to be printed. The record is printed all at once, and
+ * its colors are reset after it. This never waits for the terminal.
+ * @param record the text to print, which may have color codes in it
+ */
+void trio::RenderThread::print(const string &record)
+{
+    detail::RenderRecord queued = {false, 0, 0, record};
+    queue->push(std::move(queued));
+}
 
-#endif
-    return *this;
+/**
+ * Queues a record to be printed starting at a row/column, like a progress
+ * line that stays in one place
+ * @param point where to move the cursor before printing
+ * @param record the text to print, which may have color codes in it
+ */
+void trio::RenderThread::print(const Point &point, const string &record)
+{
+    detail::RenderRecord queued = {true, point.row, point.col, record};
+    queue->push(std::move(queued));
 }
 
 /**
- * Gets a single character from stdin.
- * Input is unbuffered, echoless, blocking. For non-blocking, use a
- * separate thread.
- * @param ch_var the variable to read a character into 
- * @return this object (for chaining inputs)
+ * Waits until everything queued so far, from any thread, is on the
+ * terminal
  */
-trio::IO &trio::IO::operator>>(char &ch_var)
+void trio::RenderThread::flush()
 {
-    unsigned char temp;
-    *this >> temp;
-    ch_var = (char)temp;
-    return *this;
+    queue->wait_printed();
 }
 
-/*  .88888.             dP                        dP      8888ba.88ba             dP   dP                      dP          
- * d8'   `8b            88                        88      88  `8b  `8b            88   88                      88          
- * 88     88 dP    dP d8888P  88d888b. dP    dP d8888P    88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
- * 88     88 88    88   88    88'  `88 88    88   88      88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
- * Y8.   .8P 88.  .88   88    88.  .88 88.  .88   88      88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
- *  `8888P'  `88888P'   dP    88Y888P' `88888P'   dP      dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
- * oooooooooooooooooooooooooo~88~oooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
- *                            dP                                                                                           
+/* 888888ba                                             dP                       8888ba.88ba             dP   dP                      dP          
+ * 88    `8b                                            88                       88  `8b  `8b            88   88                      88          
+ * a88aaaa8P' .d8888b. .d8888b. .d8888b. 88d888b. .d888b88 .d8888b. 88d888b.     88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
+ * 88   `8b.  88ooood8 88'  `"" 88'  `88 88'  `88 88'  `88 88ooood8 88'  `88     88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
+ * 88     88  88.  ... 88.  ... 88.  .88 88       88.  .88 88.  ... 88           88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
+ * dP     dP  `88888P' `88888P' `88888P' dP       `88888P8 `88888P' dP           dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
+ * ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
  * Nancyj-Underlined font
  * http://patorjk.com/software/taag/
  */
 
 /**
- * Prints a string to the terminal and interprets any color codes found
- * @param text the string to print to the terminal
- * @return a reference to this IO object, to account for chained outputs
+ * Starts the thread that writes recorded events to the file
+ * @param file the file to write to, which the RecordWriter closes
+ * @param capacity the most bytes of events that can wait to be written
  */
-trio::IO &trio::IO::operator<<(string text)
+trio::detail::RecordWriter::RecordWriter(FILE *file, size_t capacity)
+    : file(file), start(std::chrono::steady_clock::now()), ring(capacity > 0 ? capacity : 1),
+      head(0), used(0), stopping(false), failed(false)
 {
-#if defined(WINDOWS)
-    // Setup Windows if we haven't yet.
-    if (!windows_setup)
-        setupWindows();
-#endif
+    thread = std::thread(&RecordWriter::run, this);
+}
 
-    // Reset the color on every new line, easiest way to do this is just to
-    // replace every '\n' with '&00\n' (using the TrIO color escapes)
-    text = replace_all(text, "\n", "&00\n");
+/**
+ * Writes the events that are still waiting, stops the writing thread and
+ * closes the file. A character that was still cut off is recorded as
+ * U+FFFD, since the rest of it will never come.
+ */
+trio::detail::RecordWriter::~RecordWriter()
+{
+    if (!carry.empty())
+    {
+        carry.clear();
+        record("\xEF\xBF\xBD", 3, NULL, 0);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        filled.notify_one();
+    }
+    thread.join();
+    if (fclose(file) != 0)
+        failed = true;
+}
 
-    // Replace every instance of "&&" with, where X represents an
-    // invisible non-printable, "&X". We will later ignore X when printing
-    text = replace_all(text, "&&", '&' + string(1, char(0)));
+/**
+ * Records a chunk of output as an asciicast event: the time since
+ * recording started, "o" for output, and the output as a JSON string.
+ * @param first the first piece of the chunk
+ * @param first_size how many bytes are in the first piece
+ * @param second the piece that goes after it (may be NULL)
+ * @param second_size how many bytes are in the second piece
+ */
+void trio::detail::RecordWriter::record(const char *first, size_t first_size, const char *second, size_t second_size)
+{
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // Half of a character from the last chunk goes in front of this one
+    text.assign(carry);
+    text.append(first, first_size);
+    if (second_size > 0)
+        text.append(second, second_size);
+    char stamp[48];
+    const int stamp_size = snprintf(stamp, sizeof(stamp), "[%.6f, \"o\", \"", seconds);
+    event.assign(stamp, stamp_size);
+    const size_t done = append_json(event, text.data(), text.size());
+    carry.assign(text, done, string::npos);
+    if (done == 0)
+        return;
+    event += "\"]\n";
+    put(event.data(), event.size());
+}
 
-    // Split the string by "&XY" with X and Y as numeric color codes
-    vector<string> strings = rsplit(text, "&[0-8][0-8]", true);
+/**
+ * Whether every event so far was written to the file
+ * @return false if a write failed
+ */
+bool trio::detail::RecordWriter::good() const
+{
+    return !failed.load();
+}
 
-    // Print each line of the vector
-    for (int i = 0; i < strings.size(); i++)
+/**
+ * Copies bytes into the ring for the writing thread. When the file can't
+ * keep up and the ring fills, this waits for room instead of losing output.
+ * @param data the bytes to copy
+ * @param size how many bytes to copy
+ */
+void trio::detail::RecordWriter::put(const char *data, size_t size)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (size > 0)
     {
-        // Now that we've finished searching for escapes, we want the "&X"'s
-        // to become just plain '&'.
-        strings[i] = replace_all(strings[i], "&" + string(1, char(0)), string(1, '&'));
+        drained.wait(lock, [this]() { return used < ring.size(); });
+        const size_t tail = (head + used) % ring.size();
+        const size_t count = std::min(size, std::min(ring.size() - used, ring.size() - tail));
+        memcpy(&ring[tail], data, count);
+        // The writing thread waits for the first event, and then for the
+        // ring to fill halfway (or a little while)
+        const bool wake = used == 0 || (used < ring.size() / 2 && used + count >= ring.size() / 2);
+        used += count;
+        if (wake)
+            filled.notify_one();
+        data += count;
+        size -= count;
+    }
+}
 
-        // Set the color based on the first 3 characters of each substring
-        // (Make sure the substring contains a color code, it may be "")
-        if (strings[i].size() > 3 && i > 0)
+/**
+ * Writes events from the ring to the file until the Recorder goes away.
+ * Events are written in batches: once one arrives, the thread waits 10
+ * milliseconds (or until the ring is half full) for more, so a busy program
+ * doesn't wake it for every event. The file is flushed after each batch,
+ * so a recording is complete up to its last batch even if the program
+ * crashes.
+ */
+void trio::detail::RecordWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        filled.wait(lock, [this]() { return used > 0 || stopping; });
+        filled.wait_for(lock, std::chrono::milliseconds(10), [this]() { return used >= ring.size() / 2 || stopping; });
+        if (used == 0)
+            break;
+        while (used > 0)
         {
-            set_color(Color(strings[i][1] - '0', strings[i][2] - '0'));
+            // Write the part of the ring that is in one piece
+            const size_t size = std::min(used, ring.size() - head);
+            const char *data = &ring[head];
+            lock.unlock();
+            if (fwrite(data, 1, size, file) != size)
+                failed = true;
+            lock.lock();
+            head = (head + size) % ring.size();
+            used -= size;
+            drained.notify_one();
         }
+        lock.unlock();
+        if (fflush(file) != 0)
+            failed = true;
+        lock.lock();
+    }
+}
 
-        // Print the line, using either a wide or narrow stream
-        if (wide)
+/**
+ * Adds text to a JSON string. Quotes, backslashes and control characters
+ * (like the ESC of every escape sequence) are escaped, and broken UTF-8
+ * becomes U+FFFD, since JSON strings have to be valid Unicode.
+ * @param out the JSON string to add to
+ * @param text the text to add
+ * @param size how many bytes of text there are
+ * @return how many bytes were added, which is less than size when the text
+ * ends with part of a character
+ */
+size_t trio::detail::append_json(string &out, const char *text, size_t size)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t pos = 0;
+    while (pos < size)
+    {
+        // Copy runs that need no escaping all at once
+        size_t run = pos;
+        while (run < size && (unsigned char)text[run] >= 0x20 && (unsigned char)text[run] < 0x80 && text[run] != '"' && text[run] != '\\')
+            run++;
+        out.append(text + pos, run - pos);
+        pos = run;
+        if (pos == size)
+            break;
+        const unsigned char ch = (unsigned char)text[pos];
+        if (ch == '"' || ch == '\\')
         {
-            // Strings too small to contain a color code OR
-            // the first string in the vector (which can't contain a color code
-            // or it would have split into the second) should be printed in
-            // their entirety, other strings we need to skip the first 3 chars
-            // which are the color code.
-            if (strings[i].size() > 3 && i > 0)
-                // substr() let's us skip to position 3
-                *wout << strings[i].substr(3) << std::flush;
-            else
-                *wout << strings[i] << std::flush;
+            out += '\\';
+            out += (char)ch;
+            pos++;
+        }
+        else if (ch == '\n')
+        {
+            out += "\\n";
+            pos++;
+        }
+        else if (ch == '\r')
+        {
+            out += "\\r";
+            pos++;
+        }
+        else if (ch < 0x20)
+        {
+            const char escaped[] = {'\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xF]};
+            out.append(escaped, sizeof(escaped));
+            pos++;
         }
         else
         {
-            // Strings too small to contain a color code OR
-            // the first string in the vector (which can't contain a color code
-            // or it would have split into the second) should be printed in
-            // their entirety, other strings we need to skip the first 3 chars
-            // which are the color code.
-            if (strings[i].size() > 3 && i > 0)
-                // substr() let's us skip to position 3
-                *out << strings[i].substr(3) << std::flush;
-            else
-                *out << strings[i] << std::flush;
+            size_t next = pos;
+            utf8_next(text, size, next);
+            if (next - pos > 1)
+            {
+                out.append(text + pos, next - pos);
+                pos = next;
+                continue;
+            }
+            // A lead byte followed only by continuation bytes, with too few
+            // of them, is a character the next chunk finishes
+            const size_t needed = ch >= 0xF0 ? 4 : ch >= 0xE0 ? 3 : 2;
+            bool cut_off = ch >= 0xC2 && ch <= 0xF4 && size - pos < needed;
+            for (size_t i = pos + 1; cut_off && i < size; i++)
+                cut_off = ((unsigned char)text[i] & 0xC0) == 0x80;
+            if (cut_off)
+                return pos;
+            out += "\xEF\xBF\xBD";
+            pos++;
         }
-        // Reset to the default color after printing
-        set_color(Color(0, 0));
     }
-
-    // Return this IO object (for any chained outputs)
-    return *this;
+    return size;
 }
 
 /**
- * Prints a character to the terminal
- * @param letter the character to print to the terminal
- * @return a reference to this IO object, to account for chained outputs
+ * Reads a JSON string, turning its escapes back into UTF-8
+ * @param pos the opening quote, moved past the closing quote
+ * @param end the end of the text the string is in
+ * @param out set to the string's contents
+ * @return false if there isn't a well formed string at pos
  */
-trio::IO &trio::IO::operator<<(const char &letter)
+bool trio::detail::read_json(const char *&pos, const char *end, string &out)
 {
-#if defined(WINDOWS)
-    // Setup Windows if we haven't yet.
-    if (!windows_setup)
-        setupWindows();
-#endif
-
-    if (wide)
-    {
-        *wout << letter << std::flush;
-    }
-    else
+    out.clear();
+    if (pos == end || *pos != '"')
+        return false;
+    pos++;
+    while (pos < end)
     {
-        *out << letter << std::flush;
+        const char *run = pos;
+        while (run < end && *run != '"' && *run != '\\')
+            run++;
+        out.append(pos, run - pos);
+        pos = run;
+        if (pos == end)
+            return false;
+        if (*pos++ == '"')
+            return true;
+        if (pos == end)
+            return false;
+        const char escape = *pos++;
+        switch (escape)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            out += escape;
+            break;
+        case 'b':
+            out += '\b';
+            break;
+        case 'f':
+            out += '\f';
+            break;
+        case 'n':
+            out += '\n';
+            break;
+        case 'r':
+            out += '\r';
+            break;
+        case 't':
+            out += '\t';
+            break;
+        case 'u':
+        {
+            // Characters outside of the BMP are written as surrogate pairs
+            unsigned int code_point = 0;
+            for (int half = 0; half < 2; half++)
+            {
+                if (end - pos < 4)
+                    return false;
+                unsigned int unit = 0;
+                for (int i = 0; i < 4; i++)
+                {
+                    const char digit = *pos++;
+                    unit <<= 4;
+                    if (digit >= '0' && digit <= '9')
+                        unit |= digit - '0';
+                    else if (digit >= 'a' && digit <= 'f')
+                        unit |= digit - 'a' + 10;
+                    else if (digit >= 'A' && digit <= 'F')
+                        unit |= digit - 'A' + 10;
+                    else
+                        return false;
+                }
+                if (half == 1)
+                {
+                    code_point = unit >= 0xDC00 && unit <= 0xDFFF ? 0x10000 + ((code_point - 0xD800) << 10) + (unit - 0xDC00) : 0xFFFD;
+                    break;
+                }
+                code_point = unit;
+                if (unit < 0xD800 || unit > 0xDBFF || end - pos < 6 || pos[0] != '\\' || pos[1] != 'u')
+                    break;
+                pos += 2;
+            }
+            // Half of a surrogate pair isn't a character
+            if (code_point >= 0xD800 && code_point <= 0xDFFF)
+                code_point = 0xFFFD;
+            append_utf8(out, code_point);
+            break;
+        }
+        default:
+            return false;
+        }
     }
-    return *this;
+    return false;
 }
 
 /**
- * Prints an integer to the terminal
- * @param number the integer to print to the terminal
- * @return a reference to this IO object, to account for chained outputs
+ * Adds a code point to a string, encoded as UTF-8
+ * @param out the string to add to
+ * @param code_point the code point to add
  */
-trio::IO &trio::IO::operator<<(const int &number)
+void trio::detail::append_utf8(string &out, unsigned int code_point)
 {
-#if defined(WINDOWS)
-    // Setup Windows if we haven't yet.
-    if (!windows_setup)
-        setupWindows();
-#endif
-
-    if (wide)
+    if (code_point < 0x80)
+        out += (char)code_point;
+    else if (code_point < 0x800)
+    {
+        out += (char)(0xC0 | (code_point >> 6));
+        out += (char)(0x80 | (code_point & 0x3F));
+    }
+    else if (code_point < 0x10000)
     {
-        *wout << number << std::flush;
+        out += (char)(0xE0 | (code_point >> 12));
+        out += (char)(0x80 | ((code_point >> 6) & 0x3F));
+        out += (char)(0x80 | (code_point & 0x3F));
     }
     else
     {
-        *out << number << std::flush;
+        out += (char)(0xF0 | (code_point >> 18));
+        out += (char)(0x80 | ((code_point >> 12) & 0x3F));
+        out += (char)(0x80 | ((code_point >> 6) & 0x3F));
+        out += (char)(0x80 | (code_point & 0x3F));
     }
-    return *this;
 }
 
 /**
- * Prints a double to the terminal
- * @param number the double to print to the terminal
- * @return a reference to this IO object, to account for chained outputs
+ * Reads a line from a file, however long it is
+ * @param file the file to read from
+ * @param line set to the line, with its newline if it had one
+ * @return false at the end of the file
  */
-trio::IO &trio::IO::operator<<(const double &number)
+bool trio::detail::read_line(FILE *file, string &line)
 {
-#if defined(WINDOWS)
-    // Setup Windows if we haven't yet.
-    if (!windows_setup)
-        setupWindows();
-#endif
-
-    if (wide)
+    line.clear();
+    char chunk[4096];
+    while (fgets(chunk, sizeof(chunk), file))
     {
-        *wout << number << std::flush;
+        const size_t size = strlen(chunk);
+        line.append(chunk, size);
+        if (size > 0 && chunk[size - 1] == '\n')
+            return true;
     }
-    else
+    return !line.empty();
+}
+
+/**
+ * Starts recording to a file. The recording starts with an asciicast
+ * header holding its size and when it was made, and each chunk of output
+ * written to the Recorder becomes an event with the time it was written.
+ * @param path the file to record to, which is replaced if it exists
+ * @param forward the Sink to pass output on to, or NULL to only record
+ * @param rows how many rows the terminal has (0 to ask forward)
+ * @param cols how many columns the terminal has (0 to ask forward)
+ * @param capacity the most bytes of events that can wait to be written
+ * before recording waits for the file
+ */
+trio::Recorder::Recorder(const string &path, Sink *forward, unsigned short rows, unsigned short cols, size_t capacity)
+    : forward(forward)
+{
+    if ((rows == 0 || cols == 0) && (forward == NULL || !forward->size(rows, cols)))
     {
-        *out << number << std::flush;
+        rows = 0;
+        cols = 0;
     }
-    return *this;
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+        return;
+    // asciicast needs a size, so output that isn't going to a terminal is
+    // recorded at the usual one
+    fprintf(file, "{\"version\": 2, \"width\": %u, \"height\": %u, \"timestamp\": %lld}\n",
+            cols != 0 ? cols : 80u, rows != 0 ? rows : 24u, (long long)time(NULL));
+    writer.reset(new detail::RecordWriter(file, capacity));
 }
 
-/* .d88888b                              oo          dP    8888ba.88ba             dP   dP                      dP          
- * 88.    "'                                         88    88  `8b  `8b            88   88                      88          
- * `Y88888b.  88d888b. .d8888b. .d8888b. dP .d8888b. 88    88   88   88 .d8888b. d8888P 88d888b. .d8888b. .d888b88 .d8888b. 
- *       `8b  88'  `88 88ooood8 88'  `"" 88 88'  `88 88    88   88   88 88ooood8   88   88'  `88 88'  `88 88'  `88 Y8ooooo. 
- * d8'   .8P  88.  .88 88.  ... 88.  ... 88 88.  .88 88    88   88   88 88.  ...   88   88    88 88.  .88 88.  .88       88 
- *  Y88888P   88Y888P' `88888P' `88888P' dP `88888P8 dP    dP   dP   dP `88888P'   dP   dP    dP `88888P' `88888P8 `88888P' 
- * oooooooooo~88~ooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooo
- *            dP                                                                                                            
- * Nancyj-Underlined font
- * http://patorjk.com/software/taag/
+/**
+ * Writes the events that are still waiting and closes the file
  */
+trio::Recorder::~Recorder()
+{
+}
 
 /**
- * Moves the terminal's cursor to a row/column specified by
- * a Point object.
- * @param point the Point containing the row/column to move to
- * @return this object, for chaining outputs.
+ * Whether the recording's file could be opened, and everything recorded
+ * so far was written to it
+ * @return false if something went wrong
  */
-trio::IO &trio::IO::operator<<(const Point &point)
+bool trio::Recorder::good() const
 {
-#if defined(WINDOWS)
-    if (!windows_setup)
-    {
-        setupWindows();
-    }
-    // if using Windows, use windows.h
-    // We must have a reference to the active terminal for Windows
-    // Coordinates are (x, y). Columns are x, rows are y, so r/c becomes c/r
-    COORD cor = {(short)point.col, (short)point.row};
-    SetConsoleCursorPosition(stdout_terminal, cor);
-#else
-    // for some reason, row and column in ANSI start at 1, we want it to start at 0
-    int r = point.row + 1;
-    int c = point.col + 1;
-    // on *nix use ANSI escape
-    std::string pos = "\033[" + std::to_string(r) + ';' + std::to_string(c) + 'f';
-    std::cout << pos << std::flush;
-#endif
-    return *this;
+    return writer && writer->good();
 }
 
 /**
- * Changes the color of the terminal to the foreground and
- * background specified by the Color object.
- * @param color a Color object containing a foreground and background code
- * (codes are specified in trio.hpp near the top of the file)
- * @return this object, for chaining outputs.
+ * The Sink output is passed on to
+ * @return the Sink, or NULL if output is only recorded
  */
-trio::IO &trio::IO::operator<<(const Color &color)
+trio::Sink *trio::Recorder::target() const
 {
-    set_color(color);
-    return *this;
+    return forward;
 }
 
 /**
- * Sets the terminal color using a color object
- * @param c the color configuration to use on the terminal
+ * Passes output on and records it
+ * @param text the bytes to write
+ * @param size how many bytes to write
  */
-void trio::IO::set_color(Color c)
+void trio::Recorder::write(const char *text, size_t size)
 {
-    // TrIO color codes are
-    // 0: Default, 1: Black, 2: Red, 3: Yellow, 4: Green, 5: Blue, 6: Cyan,
-    // 7: Magenta, 8: White
-#if defined(WINDOWS)
-    // These arrays map Trio color codes to Windows color values
-    // For instance, 2 is Trio red, and at index 2 in the array
-    // we have 4, which is Window's code for red
-    static const unsigned short _fg[] = {7, 0, 4, 6, 2, 1, 3, 5, 7};
-    // Windows does it's codes kind of weird. The background color is defined by
-    // 16 * the foreground's code. (red=4, bg for red is 64)
-    // Then to actually set the color in windows, we will add the foreground and
-    // background color.
-    static const unsigned short _bg[] = {0, 0, 64, 96, 32, 16, 48, 80, 112};
-#else
-    // These are the ansi code equivalents to Trio color codes
-    // TrIO color codes are
-    // 0: Default, 1: Black, 2: Red, 3: Yellow, 4: Green, 5: Blue, 6: Cyan,
-    // 7: Magenta, 8: White
-    // These arrays map Trio color codes to ANSI color codes
-    // For instance, 2 is Trio red, and at index 2 in the array
-    // we have 31, which is ANSI's code for red foreground
-    static const unsigned short _fg[] = {39, 30, 31, 33, 32, 34, 36, 35, 37};
-    static const unsigned short _bg[] = {49, 40, 41, 43, 42, 44, 46, 45, 47};
-#endif
+    if (forward != NULL)
+        forward->write(text, size);
+    if (writer)
+        writer->record(text, size, NULL, 0);
+}
 
-#if defined(WINDOWS)
-    // We always need to make sure the Windows terminal is configured
-    // before we perform any kind of operations on it
-    if (!windows_setup)
-        setupWindows();
-    // Setting the color by adding the foreground and background colors
-    // Modifies our stdout terminal
-    SetConsoleTextAttribute(stdout_terminal, _fg[c.fg] + _bg[c.bg]);
-#else
-    // Print a sequence of ansi characters to color the terminal
-    if (wide)
-    {
-        // If we are using wide streams, we use wout
-        *wout << "\033[" + to_string(_fg[c.fg]) + to_string(_bg[c.bg]) + 'm' << std::flush;
-    }
-    else
-    {
-        *out << "\033[" + to_string(_fg[c.fg]) + ';' + to_string(_bg[c.bg]) + 'm' << std::flush;
-    }
-#endif
+/**
+ * Passes output in two pieces on, and records it as one event
+ * @param first the first run of bytes
+ * @param first_size how many bytes are in the first run
+ * @param second the run of bytes that goes after it
+ * @param second_size how many bytes are in the second run
+ */
+void trio::Recorder::write(const char *first, size_t first_size, const char *second, size_t second_size)
+{
+    if (forward != NULL)
+        forward->write(first, first_size, second, second_size);
+    if (writer)
+        writer->record(first, first_size, second, second_size);
 }
 
 /**
- * Calls sleep and returns IO object which allows us
- * to include waiting in output chains
- * @param ms the time in miliseconds to sleep
- * @return the IO object which this method is called from
+ * Flushes the Sink output is passed on to. The recording is written by its
+ * own thread, so this doesn't wait for it.
  */
-trio::IO &trio::IO::sleep(int ms)
+void trio::Recorder::flush()
 {
-    trio::sleep_ms(ms);
-    return *this;
+    if (forward != NULL)
+        forward->flush();
 }
 
-trio::IO &trio::IO::clear()
+/**
+ * Gets the size of the terminal behind the Sink output is passed on to
+ * @param rows set to the number of rows, if the size is known
+ * @param cols set to the number of columns, if the size is known
+ * @return whether the size is known
+ */
+bool trio::Recorder::size(unsigned short &rows, unsigned short &cols)
 {
-    trio::clear_screen();
-    return *this;
+    return forward != NULL && forward->size(rows, cols);
 }
 
-#if defined(WINDOWS)
-void trio::IO::setupWindows()
+/**
+ * Plays a recording back into a Sink, keeping the time between chunks of
+ * output (divided by speed). Events other than output, like input, are
+ * skipped. Playing at speed 0 makes a recording into a benchmark of
+ * whatever the Sink goes to.
+ * @param path the recording's file
+ * @param sink where to play the output
+ * @param speed how many times faster than recorded to play, or 0 for as
+ * fast as possible
+ * @param stats if not NULL, set to what was played
+ * @return false if the recording couldn't be opened
+ */
+bool trio::replay(const string &path, Sink &sink, double speed, ReplayStats *stats)
 {
-    // If we're using windows and it has not yet been fixed
-    if (!windows_setup)
+    typedef std::chrono::steady_clock clock;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+        return false;
+    ReplayStats totals = {0, 0, 0, 0};
+    string line;
+    string type;
+    string data;
+    const clock::time_point start = clock::now();
+    while (detail::read_line(file, line))
     {
-        // set the console mode for unicode
-        _setmode(_fileno(stdout), _O_U16TEXT);
-        // We must have a reference to the input terminal for Windows' input API
-        stdin_terminal = GetStdHandle(STD_INPUT_HANDLE);
-        // We must have a reference to the output terminal for Windows' color API
-        stdout_terminal = GetStdHandle(STD_OUTPUT_HANDLE);
-        // Mark the Windows fix as complete
-        windows_setup = true;
+        // The header is an object, and events are arrays of
+        // [time, type, data]
+        const char *pos = line.c_str();
+        const char *end = pos + line.size();
+        if (*pos != '[')
+            continue;
+        char *after;
+        const double seconds = strtod(pos + 1, &after);
+        pos = after;
+        while (pos < end && (*pos == ' ' || *pos == ','))
+            pos++;
+        if (!detail::read_json(pos, end, type) || type != "o")
+            continue;
+        while (pos < end && (*pos == ' ' || *pos == ','))
+            pos++;
+        if (!detail::read_json(pos, end, data))
+            continue;
+        if (speed > 0)
+        {
+            const clock::time_point due = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds / speed));
+            if (due > clock::now())
+            {
+                // What was played so far should be seen while we wait
+                sink.flush();
+                std::this_thread::sleep_until(due);
+            }
+        }
+        sink.write(data.data(), data.size());
+        totals.events++;
+        totals.bytes += data.size();
+        totals.recorded_ms = seconds * 1000;
     }
+    sink.flush();
+    fclose(file);
+    totals.played_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    if (stats != NULL)
+        *stats = totals;
+    return true;
 }
-#endif
\ No newline at end of file
+
+#endif // !TRIO_SEPARATE_COMPILATION || TRIO_IMPLEMENTATION